@@ -1,8 +1,25 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <vector>
 
+#if defined(_WIN32)
+    #if !defined(NOMINMAX)
+        #define NOMINMAX
+    #endif
+    #if !defined(WIN32_LEAN_AND_MEAN)
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
 class avi final {
 private:
     // The files are comprised of a collection of chunks.
@@ -137,7 +154,14 @@ public:
     #pragma pack()
     static_assert(sizeof(strf_auds_type) == 1);
 
-private:
+public:
+    // The file has an idx1 index, avih_type flag.
+    constexpr static const unsigned int avih_flag_has_index = 0x00000010;
+    // The keyframe flags in the index are reliable, avih_type flag.
+    constexpr static const unsigned int avih_flag_trust_chunk_type = 0x00000800;
+    // The chunk is a keyframe, index_type flag.
+    constexpr static const unsigned int index_flag_keyframe = 0x00000010;
+
     #pragma pack(1)
     struct index_type {
         unsigned int chunk_id;
@@ -152,17 +176,130 @@ private:
     #pragma pack()
     static_assert(sizeof(index_type) == 16);
 
+    // OpenDML super index, the 'indx' chunk of a LIST[strl] listing the standard indexes of the stream.
+    #pragma pack(1)
+    struct super_index_type {
+        // Size of each entry in four byte units, 4 for a super index.
+        unsigned short longs_per_entry;
+        // Zero for a super index.
+        unsigned char index_sub_type;
+        // Type of the index:
+        // 0x00 - Index of indexes, entries are super_index_entry_type.
+        // 0x01 - Index of chunks, the index is a standard index.
+        unsigned char index_type;
+        // Number of entries used.
+        unsigned int entries_in_use;
+        // Four letter character code of the chunks indexed, such as '00dc'.
+        unsigned int chunk_id;
+        // Reserved.
+        unsigned int reserved[3];
+    };
+    #pragma pack()
+    static_assert(sizeof(super_index_type) == 24);
+
+    #pragma pack(1)
+    struct super_index_entry_type {
+        // Offset of the standard index chunk from the start of the file.
+        unsigned long long int offset;
+        // Size of the standard index chunk.
+        unsigned int size;
+        // Duration of the chunks in the standard index in stream ticks.
+        unsigned int duration;
+    };
+    #pragma pack()
+    static_assert(sizeof(super_index_entry_type) == 16);
+
+    // OpenDML standard index, an 'ix##' chunk listing the chunks of one stream within one RIFF segment.
+    #pragma pack(1)
+    struct standard_index_type {
+        // Size of each entry in four byte units, 2 for a standard index.
+        unsigned short longs_per_entry;
+        // Zero for a standard index of frames.
+        unsigned char index_sub_type;
+        // 0x01 - Index of chunks.
+        unsigned char index_type;
+        // Number of entries used.
+        unsigned int entries_in_use;
+        // Four letter character code of the chunks indexed, such as '00dc'.
+        unsigned int chunk_id;
+        // Offset from the start of the file that entry offsets are relative to.
+        unsigned long long int base_offset;
+        // Reserved.
+        unsigned int reserved;
+    };
+    #pragma pack()
+    static_assert(sizeof(standard_index_type) == 24);
+
+    #pragma pack(1)
+    struct standard_index_entry_type {
+        // Offset of the chunk data, past the chunk header, relative to the base offset.
+        unsigned int offset;
+        // Size of the chunk data, the top bit is set when the chunk is not a keyframe.
+        unsigned int size;
+    };
+    #pragma pack()
+    static_assert(sizeof(standard_index_entry_type) == 8);
+
+    // Sidecar index cache written by open, in native byte order.
+    // The header is followed by an entry for each stream, then the strf_vids copies and frame entries they point to.
+    #pragma pack(1)
+    struct index_cache_header_type {
+        // Four letter character code 'AVIc'.
+        unsigned int identifier;
+        unsigned int version;
+        // Size, modification time and header hash of the file the cache describes.
+        unsigned long long int file_length;
+        unsigned long long int file_time;
+        unsigned long long int header_hash;
+        unsigned int stream_count;
+        // Reserved.
+        unsigned int reserved;
+    };
+    #pragma pack()
+    static_assert(sizeof(index_cache_header_type) == 40);
+
+    #pragma pack(1)
+    struct index_cache_stream_type {
+        unsigned long long int frame_count;
+        // Offset of the frame entries of the stream from the start of the cache.
+        unsigned long long int frames_offset;
+        // Offset from the start of the cache and length of a copy of the strf_vids header, the length is zero for other streams.
+        unsigned long long int strf_vids_offset;
+        unsigned long long int strf_vids_length;
+    };
+    #pragma pack()
+    static_assert(sizeof(index_cache_stream_type) == 32);
+
+    #pragma pack(1)
+    struct index_cache_frame_type {
+        // Offset of the frame data from the start of the file.
+        unsigned long long int offset;
+        unsigned int length;
+    };
+    #pragma pack()
+    static_assert(sizeof(index_cache_frame_type) == 12);
+
+    constexpr static const unsigned int index_cache_version = 1;
+
 public:
     struct frame_type {
         const unsigned char* data;
         unsigned long long int length;
     };
 
+    // A piece of a composed avi, laid out like an iovec.
+    struct gather_type {
+        const unsigned char* data;
+        unsigned long long int length;
+    };
+
 private:
-    struct chunk_node_type {
+    struct chunk_entry_type {
         const chunk_type* chunk;
+        // Form of RIFF and LIST chunks, zero for other chunks.
         unsigned int form;
-        std::vector<chunk_node_type> children;
+        // Index one past the last chunk contained within this chunk, the children of a chunk follow it in the table.
+        size_t end;
     };
 
 public:
@@ -174,299 +311,1362 @@ public:
     };
 
 private:
-    chunk_node_type root_chunk_node;
+    // Frames of a stream between the idx1 positions kept for it, a lookup scans at most this many frames of the stream.
+    static constexpr unsigned int index_checkpoint_interval = 64;
+
+    // How frames are found when looked up individually.
+    enum class lookup_type {
+        // From the frame list of the stream.
+        frames,
+        // From the OpenDML standard indexes.
+        standard_indexes,
+        // From the idx1 index.
+        index,
+        // From the frame entries of a sidecar index cache.
+        cache
+    };
+
+    struct frame_lookup_type {
+        // The OpenDML standard indexes of the stream and the number of the first frame in each.
+        std::vector<const chunk_type*> standard_indexes;
+        std::vector<unsigned long long int> first_frames;
+        // Position in the idx1 index of every index_checkpoint_interval-th frame of the stream, empty when every entry is a frame of the stream.
+        std::vector<unsigned int> index_checkpoints;
+        // Frame entries of the stream in the mapped index cache.
+        const unsigned char* cache_frames;
+        unsigned long long int frame_count;
+    };
+
+public:
+    // Expected pattern of accesses to a file opened by path, passed on to the operating system as a paging hint.
+    enum class access_type {
+        sequential,
+        random
+    };
+
+private:
+    // Flat table of the parsed chunks in file order, the contents of LIST[movi] chunks are not included.
+    std::vector<chunk_entry_type> chunks;
+    // Index in the chunk table of each RIFF chunk, OpenDML files continue after the first RIFF[AVI ] chunk with RIFF[AVIX] chunks.
+    std::vector<size_t> riff_chunks;
     const avih_type* avih;
     std::vector<stream_type> streams;
+    // The OpenDML 'indx' chunk of each stream, or null when the stream has none.
+    std::vector<const chunk_type*> stream_super_indexes;
+    // The parsed file, OpenDML index offsets are relative to its start.
+    const unsigned char* file_data;
+    unsigned long long int file_length;
+    // Frame lookups of each stream, used in place of the frame lists when the file is parsed without loading frames.
+    lookup_type lookup;
+    std::vector<frame_lookup_type> frame_lookups;
+    const chunk_type* lookup_index;
+    const chunk_type* lookup_movi;
+    // Read only mapping of a file opened by path, all parsed pointers refer into it.
+    const unsigned char* mapping_data;
+    unsigned long long int mapping_length;
+    // Read only mapping of the sidecar index cache, kept while frames are looked up from it.
+    const unsigned char* cache_data;
+    unsigned long long int cache_length;
+    // Copy of a LIST[hdrl] chunk parsed on its own, wrapped in a minimal file, all parsed pointers refer into it.
+    std::vector<unsigned char> header_list;
 
 public:
-    bool parse(const unsigned char* data, unsigned long long int length) {
+    avi()
+        : chunks()
+        , riff_chunks()
+        , avih(nullptr)
+        , streams()
+        , stream_super_indexes()
+        , file_data(nullptr)
+        , file_length(0)
+        , lookup(lookup_type::frames)
+        , frame_lookups()
+        , lookup_index(nullptr)
+        , lookup_movi(nullptr)
+        , mapping_data(nullptr)
+        , mapping_length(0)
+        , cache_data(nullptr)
+        , cache_length(0)
+        , header_list() {
+    }
+
+    ~avi() {
+        this->close();
+    }
+
+    // Parsed pointers may refer into a mapping owned by this object, so it cannot be copied.
+    avi(const avi&) = delete;
+    avi& operator=(const avi&) = delete;
+
+public:
+    // Memory map a file read only and parse it, the frame data then points directly into the mapping.
+    // Given an index cache path, the frames are read from a sidecar index cache keyed by the file size, modification time and a hash of the headers.
+    // A missing or stale cache is rebuilt once the file is parsed, failing to write it is only a warning.
+    bool open(const char* path, access_type access = access_type::sequential, bool load_frames = true, const char* index_cache_path = nullptr) {
+        this->close();
+
+        if (path == nullptr) {
+            return false;
+        }
+
+        unsigned long long int file_time = 0;
+        if (!map_file(path, access, true, this->mapping_data, this->mapping_length, file_time)) {
+            return false;
+        }
+
+        if (index_cache_path == nullptr) {
+            if (!this->parse(this->mapping_data, this->mapping_length, load_frames)) {
+                this->close();
+                return false;
+            }
+            return true;
+        }
+
+        if (!this->parse_headers(this->mapping_data, this->mapping_length)) {
+            this->close();
+            return false;
+        }
+        if (this->read_index_cache(index_cache_path, file_time, load_frames)) {
+            return true;
+        }
+        if (!this->parse_frames(load_frames)) {
+            this->close();
+            return false;
+        }
+        if (!this->write_index_cache(index_cache_path, file_time)) {
+            std::fprintf(stderr, "Warning: Failed to write index cache '%s'.\n", index_cache_path);
+        }
+        return true;
+    }
+
+    // Release a file opened by path, invalidating all parsed pointers.
+    void close() {
+        if (this->cache_data != nullptr) {
+            unmap_file(this->cache_data, this->cache_length);
+        }
+        if ((this->mapping_data == nullptr) && (this->header_list.empty())) {
+            return;
+        }
+        this->chunks.clear();
+        this->riff_chunks.clear();
+        this->avih = nullptr;
         this->streams.clear();
+        this->stream_super_indexes.clear();
+        this->file_data = nullptr;
+        this->file_length = 0;
+        this->lookup = lookup_type::frames;
+        this->frame_lookups.clear();
+        this->lookup_index = nullptr;
+        this->lookup_movi = nullptr;
+        if (this->mapping_data != nullptr) {
+            unmap_file(this->mapping_data, this->mapping_length);
+        }
+        this->header_list.clear();
+    }
+
+    // Parse the headers of a LIST[hdrl] chunk on its own, for files that are still being written, damaged or only partly read.
+    // The chunk is copied into a RIFF[AVI ] followed by an empty LIST[movi], so it need not outlive the call, and no frames are found.
+    // The OpenDML indx super indexes point into the rest of the file, so they are hidden.
+    bool parse_header_list(const unsigned char* hdrl, unsigned long long int length) {
+        this->close();
+
+        if ((hdrl == nullptr) || (length < 12) || (length > max_frame_length) || (read_u32(&hdrl[0]) != fourcc("LIST")) || (read_u32(&hdrl[8]) != fourcc("hdrl"))) {
+            std::fprintf(stderr, "Error: Failed to parse header list, it is not a LIST[hdrl] chunk.\n");
+            return false;
+        }
+
+        const unsigned long long int padded_length = length + (length % 2);
+        const unsigned int riff_length = static_cast<unsigned int>(4 + padded_length + 12);
+        const unsigned int movi_length = 4;
+        this->header_list.assign(static_cast<size_t>(8 + riff_length), 0);
+        unsigned char* data = this->header_list.data();
+        copy_bytes("RIFF", &data[0], 4);
+        copy_bytes(&riff_length, &data[4], 4);
+        copy_bytes("AVI ", &data[8], 4);
+        copy_bytes(hdrl, &data[12], static_cast<unsigned int>(length));
+        copy_bytes("LIST", &data[12 + padded_length], 4);
+        copy_bytes(&movi_length, &data[12 + padded_length + 4], 4);
+        copy_bytes("movi", &data[12 + padded_length + 8], 4);
+        hide_super_indexes(&data[12], length);
+
+        if (!this->parse(data, this->header_list.size(), false)) {
+            this->close();
+            return false;
+        }
+        return true;
+    }
+
+public:
+    // Parse an avi and find the frames of every stream.
+    // Without loading frames the frame lists are left empty when the file has an index, frames are then found with get_frame as they are needed.
+    bool parse(const unsigned char* data, unsigned long long int length, bool load_frames = true) {
+        return parse_headers(data, length) && parse_frames(load_frames);
+    }
+
+private:
+    // Parse the chunks of an avi and decode its headers.
+    bool parse_headers(const unsigned char* data, unsigned long long int length) {
+        this->chunks.clear();
+        this->riff_chunks.clear();
+        this->streams.clear();
+        this->stream_super_indexes.clear();
+        this->file_data = data;
+        this->file_length = length;
+        this->lookup = lookup_type::frames;
+        this->frame_lookups.clear();
+        this->lookup_index = nullptr;
+        this->lookup_movi = nullptr;
+
+        if (!parse_chunks(&data[0], length)) {
+            std::fprintf(stderr, "Error: Failed to parse root chunk.\n");
+            return false;
+        }
+        this->riff_chunks.push_back(0);
+
+        if (this->chunks[0].chunk->identifier != fourcc("RIFF")) {
+            std::fprintf(stderr, "Error: Root chunk is not a RIFF chunk.\n");
+            return false;
+        }
+
+        // Parse any OpenDML RIFF[AVIX] chunks following the root chunk.
+        unsigned long long int offset = 8ull + this->chunks[0].chunk->length + (this->chunks[0].chunk->length % 2);
+        while (offset + 12 <= length) {
+            const size_t entry = this->chunks.size();
+            if ((!parse_chunks(&data[offset], length - offset)) || (this->chunks[entry].chunk->identifier != fourcc("RIFF")) || (this->chunks[entry].form != fourcc("AVIX"))) {
+                std::fprintf(stderr, "Warning: Ignoring data that is not a complete 'RIFF[AVIX]' chunk after the root chunk.\n");
+                this->chunks.resize(entry);
+                break;
+            }
+            this->riff_chunks.push_back(entry);
+            offset += 8ull + this->chunks[entry].chunk->length + (this->chunks[entry].chunk->length % 2);
+        }
+
+        if (!decode_avi_header()) {
+            return false;
+        }
+
+        if (this->avih->stream_count > 255) {
+            std::fprintf(stderr, "Error: Unsupported number of streams found in file.\n");
+            return false;
+        }
+
+        if (!decode_stream_headers()) {
+            return false;
+        }
+
+        if (this->avih->stream_count != this->streams.size()) {
+            std::fprintf(stderr, "Error: Incorrect number of streams found in file.\n");
+            return false;
+        }
+
+        return true;
+    }
+
+    // Find the frames of every stream once the headers are decoded, or just prepare to look them up.
+    bool parse_frames(bool load_frames) {
+        if ((!load_frames) && (!decode_lookups())) {
+            return false;
+        }
+
+        if ((this->lookup == lookup_type::frames) && (!decode_streams())) {
+            return false;
+        }
+
+        return true;
+    }
+
+public:
+
+    // Compose an OpenDML avi, a RIFF[AVI ] chunk followed by as many RIFF[AVIX] chunks as needed.
+    // Each RIFF chunk holds up to segment_size bytes of frame chunks, along with an ix## standard index per stream.
+    // Every stream has an indx super index of its standard indexes, and an idx1 index covers the RIFF[AVI ] chunk for older readers.
+    // Every frame is a keyframe in the indexes, and the avih flags are set to advertise the idx1 index and its reliable keyframe flags.
+    // When more than one RIFF chunk is written, the avih total frames only counts the frames in the first, the LIST[odml] holds the real total.
+    // With a frame alignment above one, JUNK chunks are inserted so the data of every frame starts on a multiple of it from the start of the file.
+    bool compose(
+        const avih_type* avih,
+        const std::vector<stream_type>& streams,
+        std::vector<unsigned char>& video,
+        unsigned long long int segment_size = default_segment_size,
+        unsigned int frame_alignment = 1
+    ) {
+        video.clear();
+        compose_output_type output = { video, nullptr, {} };
+        return compose_chunks(avih, streams, output, segment_size, frame_alignment);
+    }
+
+    // Compose an OpenDML avi without copying any frame data, the layout is identical to that of compose.
+    // Only the headers and chunk framing are written to framing, the gathers list the pieces of the avi in order.
+    // Each piece points either into framing or directly at the data of a frame, ready to pass to writev or pwritev.
+    // The gathers are only valid while framing and the frame data are unchanged.
+    bool compose(
+        const avih_type* avih,
+        const std::vector<stream_type>& streams,
+        std::vector<unsigned char>& framing,
+        std::vector<gather_type>& gathers,
+        unsigned long long int segment_size = default_segment_size,
+        unsigned int frame_alignment = 1
+    ) {
+        framing.clear();
+        gathers.clear();
+        std::vector<compose_reference_type> references;
+        compose_output_type output = { framing, &references, {} };
+        if (!compose_chunks(avih, streams, output, segment_size, frame_alignment)) {
+            return false;
+        }
+
+        // Interleave the framing with the frame data it surrounds.
+        unsigned long long int framing_offset = 0;
+        for (const compose_reference_type& reference : references) {
+            if (reference.framing_offset > framing_offset) {
+                gathers.push_back({ framing.data() + framing_offset, reference.framing_offset - framing_offset });
+            }
+            if (reference.length > 0) {
+                gathers.push_back({ reference.data, reference.length });
+            }
+            framing_offset = reference.framing_offset;
+        }
+        if (framing.size() > framing_offset) {
+            gathers.push_back({ framing.data() + framing_offset, framing.size() - framing_offset });
+        }
+
+        return true;
+    }
+
+public:
+    // Offsets of the fields in a composed LIST[hdrl] chunk that avi_writer fills in once the frames are known.
+    struct header_list_layout_type {
+        unsigned long long int avih_offset;
+        std::vector<unsigned long long int> strh_offsets;
+        // Each super index header, its entries follow it.
+        std::vector<unsigned long long int> super_index_offsets;
+        unsigned long long int dmlh_offset;
+    };
+
+    // Append a LIST[hdrl] chunk, with the avih and the strh of each stream copied as given.
+    // Each indx super index has room for the given capacity of entries and lists none, they are filled in once the standard indexes are written.
+    // Shared with avi_writer, which writes the same layout a frame at a time.
+    static void compose_header_list(
+        const avih_type& avih_data,
+        const std::vector<stream_type>& streams,
+        const std::vector<unsigned int>& super_index_capacities,
+        unsigned int total_frames,
+        std::vector<unsigned char>& video,
+        header_list_layout_type& layout
+    ) {
+        layout.strh_offsets.clear();
+        layout.super_index_offsets.clear();
+
+        const unsigned long long int hdrl_offset = begin_chunk(video, "LIST", "hdrl");
+
+        const unsigned long long int avih_offset = begin_chunk(video, "avih", nullptr);
+        layout.avih_offset = video.size();
+        append_bytes(video, &avih_data, sizeof(avih_type));
+        end_chunk(video, avih_offset);
+
+        for (size_t stream = 0; stream < streams.size(); ++stream) {
+            const unsigned long long int strl_offset = begin_chunk(video, "LIST", "strl");
+
+            const unsigned long long int strh_offset = begin_chunk(video, "strh", nullptr);
+            layout.strh_offsets.push_back(video.size());
+            append_bytes(video, streams[stream].strh, sizeof(strh_type));
+            end_chunk(video, strh_offset);
+
+            const unsigned long long int strf_offset = begin_chunk(video, "strf", nullptr);
+            append_bytes(video, streams[stream].strf_vids, streams[stream].strf_vids->header_size);
+            end_chunk(video, strf_offset);
+
+            const super_index_type super_index = super_index_header(static_cast<unsigned int>(stream), 0);
+            const unsigned long long int indx_offset = begin_chunk(video, "indx", nullptr);
+            layout.super_index_offsets.push_back(video.size());
+            append_bytes(video, &super_index, sizeof(super_index_type));
+            video.resize(static_cast<size_t>(video.size() + super_index_capacities[stream] * sizeof(super_index_entry_type)), 0);
+            end_chunk(video, indx_offset);
+
+            end_chunk(video, strl_offset);
+        }
+
+        // LIST[odml]->dmlh, the total number of frames in all RIFF chunks followed by reserved space.
+        const unsigned long long int odml_offset = begin_chunk(video, "LIST", "odml");
+        const unsigned long long int dmlh_offset = begin_chunk(video, "dmlh", nullptr);
+        layout.dmlh_offset = video.size();
+        append_bytes(video, &total_frames, 4);
+        video.resize(video.size() + 244, 0);
+        end_chunk(video, dmlh_offset);
+        end_chunk(video, odml_offset);
+
+        end_chunk(video, hdrl_offset);
+    }
+
+    // The avih as written, advertising trustworthy chunk types and, once there is one, the idx1 index.
+    // When the frames are split over more than one RIFF chunk the total frames should only count those in the first, the LIST[odml] holds the real total.
+    static avih_type compose_avih(const avih_type& avih_data, unsigned int frame_alignment, bool has_index, unsigned int total_frames) {
+        avih_type composed = avih_data;
+        composed.flags |= avih_flag_trust_chunk_type;
+        composed.flags = has_index ? (composed.flags | avih_flag_has_index) : (composed.flags & ~avih_flag_has_index);
+        if (frame_alignment > 1) {
+            composed.padding_granularity = frame_alignment;
+        }
+        composed.total_frames = total_frames;
+        return composed;
+    }
+
+    // The header of the indx super index of a stream, listing a number of standard indexes.
+    static super_index_type super_index_header(unsigned int stream, unsigned int entries) {
+        super_index_type super_index = {};
+        super_index.longs_per_entry = sizeof(super_index_entry_type) / 4;
+        super_index.index_sub_type = 0x00;
+        super_index.index_type = 0x00;
+        super_index.entries_in_use = entries;
+        frame_chunk_id(stream, false, &super_index.chunk_id);
+        return super_index;
+    }
+
+    // The header of the ix## standard index of a stream, its entry offsets are relative to the base offset.
+    static standard_index_type standard_index_header(unsigned int stream, unsigned int entries, unsigned long long int base_offset) {
+        standard_index_type standard_index = {};
+        standard_index.longs_per_entry = sizeof(standard_index_entry_type) / 4;
+        standard_index.index_sub_type = 0x00;
+        standard_index.index_type = 0x01;
+        standard_index.entries_in_use = entries;
+        frame_chunk_id(stream, false, &standard_index.chunk_id);
+        standard_index.base_offset = base_offset;
+        return standard_index;
+    }
+
+    // The identifier of a frame chunk of a stream, '##dc' or '##db' for an uncompressed frame.
+    static void frame_chunk_id(unsigned int stream, bool uncompressed, void* chunk_id) {
+        char identifier[4] = {'0', '0', 'd', uncompressed ? 'b' : 'c'};
+        dec_to_hex(stream, &identifier[0]);
+        copy_bytes(identifier, chunk_id, 4);
+    }
+
+    // The identifier of the ix## standard index chunk of a stream.
+    static void index_chunk_id(unsigned int stream, void* chunk_id) {
+        char identifier[4] = {'i', 'x', '0', '0'};
+        dec_to_hex(stream, &identifier[2]);
+        copy_bytes(identifier, chunk_id, 4);
+    }
+
+    // The first video stream, the one whose frames the avih and dmlh count.
+    static size_t find_video_stream(const std::vector<stream_type>& streams) {
+        size_t video_stream = 0;
+        while ((video_stream + 1 < streams.size()) && (streams[video_stream].strh->type != fourcc("vids"))) {
+            ++video_stream;
+        }
+        return video_stream;
+    }
+
+    // Handy conversion function for stream number.
+    static void dec_to_hex(unsigned int decimal, char* characters) {
+        constexpr const char* hex_characters = "0123456789ABCDEF";
+        characters[0] = hex_characters[(decimal >> 4) & 0xF];
+        characters[1] = hex_characters[(decimal >> 0) & 0xF];
+    }
+
+    static void append_bytes(std::vector<unsigned char>& video, const void* data, unsigned long long int length) {
+        const size_t offset = video.size();
+        video.resize(static_cast<size_t>(offset + length));
+        copy_bytes(data, &video[offset], static_cast<unsigned int>(length));
+    }
+
+    // Append a chunk header, returning the offset of its length which is filled in by end_chunk.
+    static unsigned long long int begin_chunk(std::vector<unsigned char>& video, const char* identifier, const char* form) {
+        const unsigned int length = 0;
+        append_bytes(video, identifier, 4);
+        const unsigned long long int length_offset = video.size();
+        append_bytes(video, &length, 4);
+        if (form != nullptr) {
+            append_bytes(video, form, 4);
+        }
+        return length_offset;
+    }
+
+    // Fill in the length of a chunk and pad it to an even size, fails if the length does not fit.
+    static bool end_chunk(std::vector<unsigned char>& video, unsigned long long int length_offset) {
+        const unsigned long long int length = video.size() - length_offset - 4;
+        if (length > 0xFFFFFFFF) {
+            return false;
+        }
+        const unsigned int chunk_length = static_cast<unsigned int>(length);
+        copy_bytes(&chunk_length, &video[static_cast<size_t>(length_offset)], 4);
+        if (length % 2) {
+            video.push_back(0);
+        }
+        return true;
+    }
+
+private:
+    // Frame data left in place while composing, at offset in the composed avi and framing_offset in the framing.
+    struct compose_reference_type {
+        unsigned long long int offset;
+        unsigned long long int framing_offset;
+        const unsigned char* data;
+        unsigned long long int length;
+    };
+
+    struct compose_output_type {
+        std::vector<unsigned char>& bytes;
+        // Only set when gathering, frame data is then referenced rather than copied into bytes.
+        std::vector<compose_reference_type>* references;
+        unsigned long long int referenced_length;
+
+        // The size of the composed avi so far.
+        unsigned long long int size() const {
+            return bytes.size() + referenced_length;
+        }
+    };
+
+    bool compose_chunks(
+        const avih_type* avih,
+        const std::vector<stream_type>& streams,
+        compose_output_type& video,
+        unsigned long long int segment_size,
+        unsigned int frame_alignment
+    ) {
+        if ((streams.empty()) || (streams.size() > 255)) {
+            std::fprintf(stderr, "Error: Unsupported number of streams to compose.\n");
+            return false;
+        }
+        if ((frame_alignment == 0) || (frame_alignment & (frame_alignment - 1))) {
+            std::fprintf(stderr, "Error: Frame alignment must be a power of two.\n");
+            return false;
+        }
+        // The most padding that aligning a frame can take, a JUNK chunk needs room for its header.
+        const unsigned long long int alignment_padding = (frame_alignment > 1) ? (frame_alignment + sizeof(chunk_type) - 2) : 0;
+
+        // Split the frame chunks into RIFF chunks, written in stream order.
+        struct segment_type {
+            size_t first_stream;
+            size_t first_frame;
+            // The number of frames of each stream in this segment.
+            std::vector<unsigned int> frames;
+        };
+        std::vector<segment_type> segments;
+        unsigned long long int total_length = 0;
+        unsigned long long int frame_data_length = 0;
+        {
+            unsigned long long int current_size = 0;
+            for (size_t stream = 0; stream < streams.size(); ++stream) {
+                if ((streams[stream].strh == nullptr) || (streams[stream].strf_vids == nullptr)) {
+                    std::fprintf(stderr, "Error: Only video streams can be composed.\n");
+                    return false;
+                }
+                for (size_t frame = 0; frame < streams[stream].frames.size(); ++frame) {
+                    const unsigned long long int frame_length = streams[stream].frames[frame].length;
+                    if (frame_length > max_frame_length) {
+                        std::fprintf(stderr, "Error: Frame is too large to store in a chunk.\n");
+                        return false;
+                    }
+                    const unsigned long long int chunk_size = alignment_padding + 8 + frame_length + (frame_length % 2);
+                    if ((segments.empty()) || ((current_size > 0) && (current_size + chunk_size > segment_size))) {
+                        segments.push_back({ stream, frame, std::vector<unsigned int>(streams.size(), 0) });
+                        current_size = 0;
+                    }
+                    segments.back().frames[stream] += 1;
+                    current_size += chunk_size;
+                    total_length += chunk_size + sizeof(standard_index_entry_type) + sizeof(index_type);
+                    frame_data_length += frame_length;
+                }
+            }
+            if (segments.empty()) {
+                segments.push_back({ 0, 0, std::vector<unsigned int>(streams.size(), 0) });
+            }
+        }
+
+        // The number of standard indexes of each stream, and the total number of frames of the first video stream.
+        std::vector<unsigned int> super_index_entries(streams.size(), 0);
+        for (const segment_type& segment : segments) {
+            for (size_t stream = 0; stream < streams.size(); ++stream) {
+                super_index_entries[stream] += (segment.frames[stream] > 0) ? 1 : 0;
+            }
+        }
+        const size_t video_stream = find_video_stream(streams);
+
+        // Frame data referenced in place takes no space in the framing.
+        if (video.references != nullptr) {
+            total_length -= frame_data_length;
+        }
+        video.bytes.reserve(total_length + 4096 + (segments.size() + 1) * streams.size() * (sizeof(super_index_entry_type) + sizeof(chunk_type) + sizeof(standard_index_type)));
+
+        // RIFF[AVI ]->LIST[hdrl], each super index lists the standard indexes once they are written.
+        std::vector<unsigned long long int> super_index_offsets(streams.size(), 0);
+        const unsigned long long int riff_offset = begin_chunk(video, "RIFF", "AVI ");
+        {
+            const avih_type avih_data = compose_avih(*avih, frame_alignment, true, (segments.size() > 1) ? segments.front().frames[video_stream] : avih->total_frames);
+            std::vector<unsigned char> header_list;
+            header_list_layout_type layout;
+            compose_header_list(avih_data, streams, super_index_entries, static_cast<unsigned int>(streams[video_stream].frames.size()), header_list, layout);
+            for (size_t stream = 0; stream < streams.size(); ++stream) {
+                const super_index_type super_index = super_index_header(static_cast<unsigned int>(stream), super_index_entries[stream]);
+                copy_bytes(&super_index, &header_list[static_cast<size_t>(layout.super_index_offsets[stream])], sizeof(super_index_type));
+                super_index_offsets[stream] = video.size() + layout.super_index_offsets[stream] + sizeof(super_index_type);
+            }
+            append_bytes(video, header_list.data(), header_list.size());
+        }
+
+        std::vector<unsigned int> super_index_written(streams.size(), 0);
+        std::vector<index_type> indexes;
+        unsigned long long int extended_riff_offset = 0;
+        for (size_t segment = 0; segment < segments.size(); ++segment) {
+            if (segment > 0) {
+                if (!end_chunk(video, (segment == 1) ? riff_offset : extended_riff_offset)) {
+                    std::fprintf(stderr, "Error: Failed to compose avi, 'RIFF' chunk is too large.\n");
+                    return false;
+                }
+                extended_riff_offset = begin_chunk(video, "RIFF", "AVIX");
+            }
+
+            // RIFF[AVI ]->LIST[movi] or RIFF[AVIX]->LIST[movi]
+            const unsigned long long int movi_offset = begin_chunk(video, "LIST", "movi");
+            // Offsets are relative to the RIFF[AVI ]->LIST[movi] or RIFF[AVIX]->LIST[movi] chunk.
+            const unsigned long long int base_offset = movi_offset - 4;
+            std::vector<standard_index_entry_type> standard_index_entries;
+            for (size_t stream = segments[segment].first_stream; stream < streams.size(); ++stream) {
+                const size_t first_frame = (stream == segments[segment].first_stream) ? segments[segment].first_frame : 0;
+                for (size_t frame = first_frame; frame < first_frame + segments[segment].frames[stream]; ++frame) {
+                    const frame_type& frame_data = streams[stream].frames[frame];
+                    char chunk_id[4];
+                    frame_chunk_id(static_cast<unsigned int>(stream), false, chunk_id);
+                    append_alignment(video, frame_alignment);
+                    const unsigned long long int chunk_offset = begin_chunk(video, chunk_id, nullptr);
+                    // Every frame is a keyframe, so the top bit of the size is never set.
+                    standard_index_entries.push_back({ static_cast<unsigned int>(video.size() - base_offset), static_cast<unsigned int>(frame_data.length) });
+                    append_frame(video, frame_data);
+                    end_chunk(video, chunk_offset);
+
+                    if (segment == 0) {
+                        // Offsets are relative to the LIST[movi] form, every frame is a keyframe.
+                        index_type index;
+                        copy_bytes(chunk_id, &index.chunk_id, 4);
+                        index.flags = index_flag_keyframe;
+                        index.offset = static_cast<unsigned int>(chunk_offset - 4 - (movi_offset + 4));
+                        index.size = static_cast<unsigned int>(frame_data.length);
+                        indexes.push_back(index);
+                    }
+                }
+            }
+
+            // RIFF[AVI ]->LIST[movi]->ix## or RIFF[AVIX]->LIST[movi]->ix##
+            size_t standard_index_entry = 0;
+            for (size_t stream_index = 0; stream_index < streams.size(); ++stream_index) {
+                const unsigned int frames = segments[segment].frames[stream_index];
+                if (frames == 0) {
+                    continue;
+                }
+                char ix_chunk_id[4];
+                index_chunk_id(static_cast<unsigned int>(stream_index), ix_chunk_id);
+                const standard_index_type standard_index = standard_index_header(static_cast<unsigned int>(stream_index), frames, base_offset);
+
+                const unsigned long long int ix_offset = begin_chunk(video, ix_chunk_id, nullptr);
+                append_bytes(video, &standard_index, sizeof(standard_index_type));
+                append_bytes(video, &standard_index_entries[standard_index_entry], frames * sizeof(standard_index_entry_type));
+                standard_index_entry += frames;
+                end_chunk(video, ix_offset);
+
+                super_index_entry_type super_index_entry;
+                super_index_entry.offset = ix_offset - 4;
+                super_index_entry.size = static_cast<unsigned int>(video.size() - super_index_entry.offset);
+                super_index_entry.duration = frames;
+                patch_bytes(video, super_index_offsets[stream_index] + super_index_written[stream_index] * sizeof(super_index_entry_type), &super_index_entry, sizeof(super_index_entry_type));
+                super_index_written[stream_index] += 1;
+            }
+
+            if (!end_chunk(video, movi_offset)) {
+                std::fprintf(stderr, "Error: Failed to compose avi, 'LIST[movi]' chunk is too large.\n");
+                return false;
+            }
+
+            // RIFF[AVI ]->idx1
+            if (segment == 0) {
+                const unsigned long long int idx1_offset = begin_chunk(video, "idx1", nullptr);
+                for (const index_type& index : indexes) {
+                    append_bytes(video, &index, sizeof(index_type));
+                }
+                if (!end_chunk(video, idx1_offset)) {
+                    std::fprintf(stderr, "Error: Failed to compose avi, 'idx1' chunk is too large.\n");
+                    return false;
+                }
+            }
+        }
+
+        if (!end_chunk(video, (segments.size() == 1) ? riff_offset : extended_riff_offset)) {
+            std::fprintf(stderr, "Error: Failed to compose avi, 'RIFF' chunk is too large.\n");
+            return false;
+        }
+
+        return true;
+    }
+
+public:
+    const avih_type* get_avih() const {
+        return this->avih;
+    }
+
+    size_t get_streams() const {
+        return this->streams.size();
+    }
+
+    const stream_type& get_stream(size_t stream_index) const {
+        return this->streams[stream_index];
+    }
+
+    // Empty when the file was parsed without loading frames and has an index, use get_frame instead.
+    const std::vector<frame_type>& get_frames(size_t stream_index) const {
+        return this->streams[stream_index].frames;
+    }
+
+    unsigned long long int get_frame_count(size_t stream_index) const {
+        if (this->lookup == lookup_type::frames) {
+            return this->streams[stream_index].frames.size();
+        }
+        return this->frame_lookups[stream_index].frame_count;
+    }
+
+    // Find a frame by number, reading a single index entry when the frames were not loaded.
+    // Takes constant time, other than a search of the few OpenDML standard indexes of the stream or a short scan of the idx1 index of a file with several streams.
+    // Nothing parsed is changed, so once parsing has finished frames can be found from several threads at once.
+    bool get_frame(size_t stream_index, unsigned long long int frame_number, frame_type& frame) const {
+        if ((stream_index >= this->streams.size()) || (frame_number >= this->get_frame_count(stream_index))) {
+            return false;
+        }
+
+        switch (this->lookup) {
+            case lookup_type::frames: {
+                frame = this->streams[stream_index].frames[frame_number];
+                return true;
+            }
+            case lookup_type::standard_indexes: {
+                const frame_lookup_type& frame_lookup = this->frame_lookups[stream_index];
+                const size_t standard_index_number = static_cast<size_t>(std::upper_bound(frame_lookup.first_frames.begin(), frame_lookup.first_frames.end(), frame_number) - frame_lookup.first_frames.begin()) - 1;
+                const chunk_type* chunk_standard_index = frame_lookup.standard_indexes[standard_index_number];
+                standard_index_type standard_index;
+                copy_bytes(&reinterpret_cast<const unsigned char*>(chunk_standard_index)[sizeof(chunk_type)], &standard_index, sizeof(standard_index_type));
+                return read_standard_index_entry(chunk_standard_index, standard_index, static_cast<unsigned int>(frame_number - frame_lookup.first_frames[standard_index_number]), frame);
+            }
+            case lookup_type::index: {
+                const frame_lookup_type& frame_lookup = this->frame_lookups[stream_index];
+                const unsigned char* index_data = &reinterpret_cast<const unsigned char*>(this->lookup_index)[sizeof(chunk_type)];
+                index_type index;
+                if (frame_lookup.index_checkpoints.empty()) {
+                    copy_bytes(&index_data[frame_number * sizeof(index_type)], &index, sizeof(index_type));
+                } else {
+                    // Scan on from the nearest earlier checkpoint, the entries were checked when the index was decoded.
+                    unsigned long long int position = frame_lookup.index_checkpoints[static_cast<size_t>(frame_number / index_checkpoint_interval)];
+                    unsigned long long int remaining = frame_number % index_checkpoint_interval;
+                    while (true) {
+                        copy_bytes(&index_data[position * sizeof(index_type)], &index, sizeof(index_type));
+                        if (static_cast<size_t>(hex_to_dec((index.chunk_id >> 8) & 0xFF) + hex_to_dec((index.chunk_id >> 0) & 0xFF) * 16) == stream_index) {
+                            if (remaining == 0) {
+                                break;
+                            }
+                            --remaining;
+                        }
+                        ++position;
+                    }
+                }
+                if (8ull + index.offset + index.size > this->lookup_movi->length) {
+                    std::fprintf(stderr, "Error: Failed to find frame. 'RIFF[AVI ]->idx1' chunk index offset is not a valid size.\n");
+                    return false;
+                }
+                frame.data = &reinterpret_cast<const unsigned char*>(this->lookup_movi)[sizeof(chunk_type) + index.offset + sizeof(chunk_type)];
+                frame.length = index.size;
+                return true;
+            }
+            case lookup_type::cache: {
+                index_cache_frame_type cache_frame;
+                copy_bytes(&this->frame_lookups[stream_index].cache_frames[frame_number * sizeof(index_cache_frame_type)], &cache_frame, sizeof(index_cache_frame_type));
+                if ((cache_frame.offset > this->file_length) || (cache_frame.length > this->file_length - cache_frame.offset)) {
+                    std::fprintf(stderr, "Error: Failed to find frame. Index cache frame is outside the file.\n");
+                    return false;
+                }
+                frame.data = &this->file_data[cache_frame.offset];
+                frame.length = cache_frame.length;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Offset of the data of a frame from the start of the parsed file, for reading it without going through the parsed data.
+    unsigned long long int get_frame_offset(const frame_type& frame) const {
+        return static_cast<unsigned long long int>(frame.data - this->file_data);
+    }
+
+    // Whether a frame is an uncompressed '##db' chunk, such as a frame huffyuv::encode stored, rather than a compressed '##dc' chunk.
+    // Uncompressed RGB frames are bottom-up, as huffyuv::encode stores them.
+    bool is_frame_uncompressed(const frame_type& frame) const {
+        if ((frame.data < this->file_data + sizeof(chunk_type)) || (frame.data > this->file_data + this->file_length)) {
+            return false;
+        }
+        const unsigned char* identifier = frame.data - sizeof(chunk_type);
+        return (identifier[2] == 'd') && (identifier[3] == 'b');
+    }
+
+    // Time in seconds at which a frame of a stream is shown, from the strh scale and rate.
+    double get_frame_time(size_t stream_index, unsigned long long int frame_number) const {
+        unsigned long long int rate = 0;
+        unsigned long long int scale = 0;
+        if (!this->get_frame_rate(stream_index, rate, scale)) {
+            return 0.0;
+        }
+        return static_cast<double>(this->streams[stream_index].strh->start + frame_number) * static_cast<double>(scale) / static_cast<double>(rate);
+    }
+
+    // Number of the frame of a stream shown at a time in seconds, clamped to the frames of the stream.
+    unsigned long long int get_frame_number(size_t stream_index, double seconds) const {
+        const unsigned long long int frame_count = this->get_frame_count(stream_index);
+        unsigned long long int rate = 0;
+        unsigned long long int scale = 0;
+        if ((frame_count == 0) || (!this->get_frame_rate(stream_index, rate, scale))) {
+            return 0;
+        }
+        // Allow for rounding of times returned by get_frame_time.
+        const double position = (seconds * static_cast<double>(rate) / static_cast<double>(scale)) - static_cast<double>(this->streams[stream_index].strh->start) + 1e-6;
+        if (!(position > 0.0)) {
+            return 0;
+        }
+        if (position >= static_cast<double>(frame_count - 1)) {
+            return frame_count - 1;
+        }
+        return static_cast<unsigned long long int>(position);
+    }
+
+public:
+    // Default amount of frame data in each RIFF chunk composed, small enough for readers limited to 32 bit sizes.
+    constexpr static const unsigned long long int default_segment_size = 0x40000000;
+    // The top bit of a standard index entry size is reserved, so frames must be smaller.
+    constexpr static const unsigned long long int max_frame_length = 0x7FFFFFFF;
+    // Frame alignment that lets frames be read with O_DIRECT or FILE_FLAG_NO_BUFFERING, the sector and page size of most systems.
+    constexpr static const unsigned int direct_io_alignment = 0x1000;
+
+public:
+    constexpr static unsigned int fourcc(const char* data) {
+        return  (static_cast<unsigned int>(data[3]) << 24) |
+                (static_cast<unsigned int>(data[2]) << 16) |
+                (static_cast<unsigned int>(data[1]) <<  8) |
+                (static_cast<unsigned int>(data[0]) <<  0);
+    }
+
+    // Handy conversion function for stream number.
+    constexpr static int hex_to_dec(unsigned int character) {
+        if (('0' <= character) && (character <= '9')) {
+            return static_cast<int>(character - '0');
+        }
+        if (('a' <= character) && (character <= 'f')) {
+            return static_cast<int>(10 + (character - 'a'));
+        }
+        if (('A' <= character) && (character <= 'F')) {
+            return static_cast<int>(10 + (character - 'A'));
+        }
+        return -1;
+    }
+
+    // Read a little endian 32 bit value, such as a chunk identifier or length, from unaligned data.
+    static unsigned int read_u32(const unsigned char* data) {
+        unsigned int value = 0;
+        copy_bytes(data, &value, 4);
+        return value;
+    }
+
+private:
+    constexpr static void copy_bytes(const void* source, void* destination, unsigned int length) {
+        const unsigned char* data_source = static_cast<const unsigned char*>(source);
+        unsigned char* data_destination = static_cast<unsigned char*>(destination);
+        while (length--) {
+            *data_destination++ = *data_source++;
+        }
+    }
+
+    static void append_bytes(compose_output_type& video, const void* data, unsigned long long int length) {
+        append_bytes(video.bytes, data, length);
+    }
+
+    static void append_zeros(compose_output_type& video, unsigned long long int length) {
+        video.bytes.resize(video.bytes.size() + length, 0);
+    }
+
+    // Append the data of a frame, or when gathering, reference it where it is.
+    static void append_frame(compose_output_type& video, const frame_type& frame) {
+        if (video.references == nullptr) {
+            append_bytes(video, frame.data, frame.length);
+            return;
+        }
+        video.references->push_back({ video.size(), video.bytes.size(), frame.data, frame.length });
+        video.referenced_length += frame.length;
+    }
+
+    // Append a JUNK chunk so the data of a chunk begun next starts on a multiple of the alignment, the padding is never shorter than a chunk header.
+    static void append_alignment(compose_output_type& video, unsigned int alignment) {
+        unsigned long long int padding = (alignment - ((video.size() + sizeof(chunk_type)) % alignment)) % alignment;
+        while ((padding > 0) && (padding < sizeof(chunk_type))) {
+            padding += alignment;
+        }
+        if (padding > 0) {
+            const unsigned long long int junk_offset = begin_chunk(video, "JUNK", nullptr);
+            append_zeros(video, padding - sizeof(chunk_type));
+            end_chunk(video, junk_offset);
+        }
+    }
+
+    // Overwrite bytes already composed, the offset is in the composed avi and never falls inside referenced frame data.
+    static void patch_bytes(compose_output_type& video, unsigned long long int offset, const void* data, unsigned int length) {
+        unsigned long long int framing_offset = offset;
+        if ((video.references != nullptr) && (!video.references->empty())) {
+            // Skip the frame data referenced before the offset.
+            const auto reference = std::upper_bound(
+                video.references->begin(), video.references->end(), offset,
+                [](unsigned long long int value, const compose_reference_type& element) {
+                    return value < element.offset;
+                }
+            );
+            if (reference != video.references->begin()) {
+                const compose_reference_type& previous = *(reference - 1);
+                framing_offset = offset - (previous.offset - previous.framing_offset) - previous.length;
+            }
+        }
+        copy_bytes(data, &video.bytes[framing_offset], length);
+    }
+
+    // As above, the offset is in the composed avi rather than the framing.
+    static unsigned long long int begin_chunk(compose_output_type& video, const char* identifier, const char* form) {
+        return video.referenced_length + begin_chunk(video.bytes, identifier, form);
+    }
+
+    // As above, the frame data referenced in place counts towards the length.
+    static bool end_chunk(compose_output_type& video, unsigned long long int length_offset) {
+        const unsigned long long int length = video.size() - length_offset - 4;
+        if (length > 0xFFFFFFFF) {
+            return false;
+        }
+        const unsigned int chunk_length = static_cast<unsigned int>(length);
+        patch_bytes(video, length_offset, &chunk_length, 4);
+        if (length % 2) {
+            video.bytes.push_back(0);
+        }
+        return true;
+    }
+
+public:
+#if defined(_WIN32)
+    using file_type = HANDLE;
+#else
+    using file_type = int;
+#endif
+
+    // Open a file read only for pread style access, it can still be written by others.
+    static bool open_file(const char* path, access_type access, bool report_errors, file_type& file) {
+#if defined(_WIN32)
+        const DWORD flags = (access == access_type::sequential) ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | flags, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            if (report_errors) {
+                std::fprintf(stderr, "Error: Failed to open file '%s'.\n", path);
+            }
+            return false;
+        }
+#else
+        file = ::open(path, O_RDONLY);
+        if (file < 0) {
+            if (report_errors) {
+                std::fprintf(stderr, "Error: Failed to open file '%s'.\n", path);
+            }
+            return false;
+        }
+    #if defined(POSIX_FADV_SEQUENTIAL) && defined(POSIX_FADV_RANDOM)
+        // The hint is only advisory, so failing to apply it is not an error.
+        posix_fadvise(file, 0, 0, (access == access_type::sequential) ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_RANDOM);
+    #endif
+#endif
+        return true;
+    }
+
+    // Close a file opened with open_file, if it is open.
+    static void close_file(file_type& file) {
+#if defined(_WIN32)
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+            file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (file >= 0) {
+            ::close(file);
+            file = -1;
+        }
+#endif
+    }
+
+    // Read up to a length of bytes from a position without moving the file pointer, so any number of threads can read one file.
+    // Returns the number of bytes read, fewer than the length only at the end of the file or on an error.
+    static unsigned long long int read_at(file_type file, unsigned long long int position, unsigned char* data, unsigned long long int length) {
+        unsigned long long int total = 0;
+        while (total < length) {
+#if defined(_WIN32)
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = static_cast<DWORD>(position + total);
+            overlapped.OffsetHigh = static_cast<DWORD>((position + total) >> 32);
+            DWORD read = 0;
+            const DWORD request = static_cast<DWORD>((length - total < 0x40000000) ? (length - total) : 0x40000000);
+            if ((!ReadFile(file, &data[total], request, &read, &overlapped)) || (read == 0)) {
+                break;
+            }
+#else
+            const size_t request = static_cast<size_t>((length - total < 0x40000000) ? (length - total) : 0x40000000);
+            const ssize_t read = pread(file, &data[total], request, static_cast<off_t>(position + total));
+            if (read <= 0) {
+                break;
+            }
+#endif
+            total += static_cast<unsigned long long int>(read);
+        }
+        return total;
+    }
 
-        if (!parse_chunks(&data[0], length, this->root_chunk_node)) {
-            std::fprintf(stderr, "Error: Failed to parse root chunk.\n");
+    // Memory map a file read only, along with its modification time.
+    static bool map_file(const char* path, access_type access, bool report_errors, const unsigned char*& mapping_data, unsigned long long int& mapping_length, unsigned long long int& file_time) {
+#if defined(_WIN32)
+        const DWORD flags = (access == access_type::sequential) ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+        // A checkpointed file can be opened while it is still being written.
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | flags, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            if (report_errors) {
+                std::fprintf(stderr, "Error: Failed to open file '%s'.\n", path);
+            }
             return false;
         }
-
-        if (this->root_chunk_node.chunk->identifier != fourcc("RIFF")) {
-            std::fprintf(stderr, "Error: Root chunk is not a RIFF chunk.\n");
+        LARGE_INTEGER file_size;
+        FILETIME write_time;
+        if ((!GetFileSizeEx(file, &file_size)) || (file_size.QuadPart <= 0) || (!GetFileTime(file, nullptr, nullptr, &write_time))) {
+            if (report_errors) {
+                std::fprintf(stderr, "Error: Failed to get size of file '%s'.\n", path);
+            }
+            CloseHandle(file);
             return false;
         }
-
-        if (!decode_avi_header()) {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr) {
+            if (report_errors) {
+                std::fprintf(stderr, "Error: Failed to map file '%s'.\n", path);
+            }
             return false;
         }
-
-        if (this->avih->stream_count > 255) {
-            std::fprintf(stderr, "Error: Unsupported number of streams found in file.\n");
+        // The view keeps the mapping alive once the handle is closed.
+        void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (data == nullptr) {
+            if (report_errors) {
+                std::fprintf(stderr, "Error: Failed to map file '%s'.\n", path);
+            }
             return false;
         }
-
-        if (!decode_stream_headers()) {
+        mapping_data = static_cast<const unsigned char*>(data);
+        mapping_length = static_cast<unsigned long long int>(file_size.QuadPart);
+        file_time = (static_cast<unsigned long long int>(write_time.dwHighDateTime) << 32) | write_time.dwLowDateTime;
+#else
+        const int file = ::open(path, O_RDONLY);
+        if (file < 0) {
+            if (report_errors) {
+                std::fprintf(stderr, "Error: Failed to open file '%s'.\n", path);
+            }
             return false;
         }
-
-        if (this->avih->stream_count != this->streams.size()) {
-            std::fprintf(stderr, "Error: Incorrect number of streams found in file.\n");
+        struct stat file_status;
+        if ((fstat(file, &file_status) != 0) || (file_status.st_size <= 0)) {
+            if (report_errors) {
+                std::fprintf(stderr, "Error: Failed to get size of file '%s'.\n", path);
+            }
+            ::close(file);
             return false;
         }
-
-        if (!decode_streams()) {
+        // The mapping stays valid once the file is closed.
+        void* data = mmap(nullptr, static_cast<size_t>(file_status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+        if (data == MAP_FAILED) {
+            if (report_errors) {
+                std::fprintf(stderr, "Error: Failed to map file '%s'.\n", path);
+            }
             return false;
         }
-
+        // The hint is only advisory, so failing to apply it is not an error.
+        posix_madvise(data, static_cast<size_t>(file_status.st_size), (access == access_type::sequential) ? POSIX_MADV_SEQUENTIAL : POSIX_MADV_RANDOM);
+        mapping_data = static_cast<const unsigned char*>(data);
+        mapping_length = static_cast<unsigned long long int>(file_status.st_size);
+    #if defined(__APPLE__)
+        file_time = static_cast<unsigned long long int>(file_status.st_mtimespec.tv_sec) * 1000000000ull + static_cast<unsigned long long int>(file_status.st_mtimespec.tv_nsec);
+    #else
+        file_time = static_cast<unsigned long long int>(file_status.st_mtim.tv_sec) * 1000000000ull + static_cast<unsigned long long int>(file_status.st_mtim.tv_nsec);
+    #endif
+#endif
         return true;
     }
 
-    bool compose(
-        const avih_type* avih,
-        const std::vector<stream_type>& streams,
-        std::vector<unsigned char>& video
-    ) {
-        constexpr static const auto dec_to_hex = [](int decimal, char* characters){
-            constexpr const char* hex_characters = "0123456789ABCDEF";
-            characters[0] = hex_characters[(decimal >> 4) & 0xF];
-            characters[1] = hex_characters[(decimal >> 0) & 0xF];
-        };
-
-        video.clear();
+    static void unmap_file(const unsigned char*& mapping_data, unsigned long long int& mapping_length) {
+#if defined(_WIN32)
+        UnmapViewOfFile(mapping_data);
+#else
+        munmap(const_cast<unsigned char*>(mapping_data), static_cast<size_t>(mapping_length));
+#endif
+        mapping_data = nullptr;
+        mapping_length = 0;
+    }
 
-        unsigned long long int index = 0;
-        {
-            unsigned int riff_size =
-                4 +                                                     // CHUNK: RIFF FORM
-                4 + 4 +                                                 // CHUNK: LIST[hdrl]
-                4 +                                                     // CHUNK: LIST[hdrl] FORM
-                4 + 4 +                                                 // CHUNK: avih
-                sizeof(avih_type) +                                     // DATA:  avih_type
-                4 + 4 +                                                 // CHUNK: LIST[strl]
-                4;                                                      // CHUNK: LIST[strl] FORM
-            for (size_t stream = 0; stream < streams.size(); ++stream) {
-                riff_size +=
-                    4 + 4 +                                             // CHUNK: strh
-                    sizeof(strh_type) +                                 // DATA:  strh_type
-                    4 + 4 +                                             // CHUNK: strf_vids
-                    streams[stream].strf_vids->header_size +            // DATA:  strf_vids_type
-                    streams[stream].strf_vids->header_size % 2;         // ALIGNMENT
-            }
-            riff_size +=
-                4 + 4 +                                                 // CHUNK: movi
-                4;                                                      // CHUNK: movi FORM
-            for (size_t stream = 0; stream < streams.size(); ++stream) {
-                for (size_t frame = 0; frame < streams[stream].frames.size(); ++frame) {
-                    riff_size +=
-                        4 + 4 +                                         // CHUNK: XXdc
-                        streams[stream].frames[frame].length +          // DATA:  frame
-                        streams[stream].frames[frame].length % 2;       // ALIGNMENT
-                }
-            }
-            video.resize(8 + riff_size);
-            copy_bytes("RIFF", &video[index], 4); index += 4;
-            copy_bytes(&riff_size, &video[index], 4); index += 4;
-            copy_bytes("AVI ", &video[index], 4); index += 4;
-
-            {
-                unsigned int hdrl_size =
-                    4 +                                                 // CHUNK: LIST[hdrl] FORM
-                    4 + 4 +                                             // CHUNK: avih
-                    sizeof(avih_type) +                                 // DATA:  avih_type
-                    4 + 4 +                                             // CHUNK: LIST[strl]
-                    4;                                                  // CHUNK: LIST[strl] FORM
-                for (size_t stream = 0; stream < streams.size(); ++stream) {
-                    hdrl_size +=
-                        4 + 4 +                                         // CHUNK: strh
-                        sizeof(strh_type) +                             // DATA:  strh_type
-                        4 + 4 +                                         // CHUNK: strf_vids
-                        streams[stream].strf_vids->header_size +        // DATA:  strf_vids_type
-                        streams[stream].strf_vids->header_size % 2;     // ALIGNMENT
-                }
-                copy_bytes("LIST", &video[index], 4); index += 4;
-                copy_bytes(&hdrl_size, &video[index], 4); index += 4;
-                copy_bytes("hdrl", &video[index], 4); index += 4;
-
-                {
-                    const unsigned int avih_size = sizeof(avih_type);
-                    copy_bytes("avih", &video[index], 4); index += 4;
-                    copy_bytes(&avih_size, &video[index], 4); index += 4;
-                    copy_bytes(avih, &video[index], avih_size); index += avih_size;
-
-                    unsigned int strl_size = 4;                         // CHUNK: LIST[strl] FORM
-                    for (size_t stream = 0; stream < streams.size(); ++stream) {
-                        strl_size +=
-                            4 + 4 +                                     // CHUNK: strh
-                            sizeof(strh_type) +                         // DATA:  strh_type
-                            4 + 4 +                                     // CHUNK: strf_vids
-                            streams[stream].strf_vids->header_size +    // DATA:  strf_vids_type
-                            streams[stream].strf_vids->header_size % 2; // ALIGNMENT
-                    }
-                    copy_bytes("LIST", &video[index], 4); index += 4;
-                    copy_bytes(&strl_size, &video[index], 4); index += 4;
-                    copy_bytes("strl", &video[index], 4); index += 4;
-
-
-                    for (size_t stream = 0; stream < streams.size(); ++stream) {
-                        const strh_type* strh = streams[stream].strh;
-                        const unsigned int strh_size = sizeof(strh_type);
-                        copy_bytes("strh", &video[index], 4); index += 4;
-                        copy_bytes(&strh_size, &video[index], 4); index += 4;
-                        copy_bytes(strh, &video[index], strh_size); index += strh_size;
-
-                        const strf_vids_type* strf_vids = streams[stream].strf_vids;
-                        const unsigned int strf_vids_size = strf_vids->header_size;
-                        copy_bytes("strf", &video[index], 4); index += 4;
-                        copy_bytes(&strf_vids_size, &video[index], 4); index += 4;
-                        copy_bytes(strf_vids, &video[index], strf_vids_size); index += strf_vids_size + (strf_vids_size % 2);
-                    }
-                }
+private:
+    // Rename the indx chunks of a LIST[hdrl]->LIST[strl] to JUNK, so they are skipped when parsed.
+    static void hide_super_indexes(unsigned char* list, unsigned long long int list_length) {
+        unsigned long long int offset = 12;
+        while (offset + 8 <= list_length) {
+            const unsigned int length = read_u32(&list[offset + 4]);
+            if ((read_u32(&list[offset]) == fourcc("LIST")) && (offset + 12 <= list_length) && (read_u32(&list[offset + 8]) == fourcc("strl"))) {
+                hide_super_indexes(&list[offset], (8ull + length < list_length - offset) ? 8ull + length : list_length - offset);
             }
-
-            {
-                unsigned int movi_size = 4;                             // CHUNK: movi FORM
-                for (size_t stream = 0; stream < streams.size(); ++stream) {
-                    for (size_t frame = 0; frame < streams[stream].frames.size(); ++frame) {
-                        movi_size +=
-                            4 + 4 +                                     // CHUNK: XXdc
-                            streams[stream].frames[frame].length +      // DATA:  frame
-                            streams[stream].frames[frame].length % 2;   // ALIGNMENT
-                    }
-                }
-                copy_bytes("LIST", &video[index], 4); index += 4;
-                copy_bytes(&movi_size, &video[index], 4); index += 4;
-                copy_bytes("movi", &video[index], 4); index += 4;
-
-                for (size_t stream = 0; stream < streams.size(); ++stream) {
-                    for (size_t frame = 0; frame < streams[stream].frames.size(); ++frame) {
-                        char stream_id[4] = {'0', '0', 'd', 'c'};
-                        dec_to_hex(stream, stream_id);
-                        copy_bytes(stream_id, &video[index], 4); index += 4;
-                        copy_bytes(&streams[stream].frames[frame].length, &video[index], 4); index += 4;
-                        copy_bytes(streams[stream].frames[frame].data, &video[index], streams[stream].frames[frame].length); index += streams[stream].frames[frame].length + (streams[stream].frames[frame].length % 2);
-                    }
-                }
+            else if (read_u32(&list[offset]) == fourcc("indx")) {
+                copy_bytes("JUNK", &list[offset], 4);
             }
+            offset += 8ull + length + (length % 2);
         }
-
-        return (video.size() == index);
     }
 
-public:
-    const avih_type* get_avih() const {
-        return this->avih;
+    // FNV-1a hash of the headers, from the start of the file to the end of the RIFF[AVI ]->LIST[hdrl] chunk.
+    unsigned long long int hash_headers() const {
+        const size_t node = find_chunk(0, fourcc("LIST"), fourcc("hdrl"));
+        const unsigned char* end = &reinterpret_cast<const unsigned char*>(this->chunks[node].chunk)[sizeof(chunk_type) + this->chunks[node].chunk->length];
+        unsigned long long int hash = 0xCBF29CE484222325;
+        for (const unsigned char* data = this->file_data; data < end; ++data) {
+            hash = (hash ^ *data) * 0x00000100000001B3;
+        }
+        return hash;
     }
 
-    size_t get_streams() const {
-        return this->streams.size();
-    }
+    // Find the frames from a sidecar index cache, fails without an error when the cache is missing or does not match the file.
+    bool read_index_cache(const char* path, unsigned long long int file_time, bool load_frames) {
+        unsigned long long int cache_time = 0;
+        if (!map_file(path, access_type::sequential, false, this->cache_data, this->cache_length, cache_time)) {
+            return false;
+        }
 
-    const stream_type& get_stream(size_t stream_index) const {
-        return this->streams[stream_index];
-    }
+        index_cache_header_type header = {};
+        if (this->cache_length >= sizeof(index_cache_header_type)) {
+            copy_bytes(this->cache_data, &header, sizeof(index_cache_header_type));
+        }
+        if (
+            (header.identifier != fourcc("AVIc")) ||
+            (header.version != index_cache_version) ||
+            (header.file_length != this->file_length) ||
+            (header.file_time != file_time) ||
+            (header.stream_count != this->streams.size()) ||
+            (header.header_hash != hash_headers()) ||
+            (this->cache_length < sizeof(index_cache_header_type) + header.stream_count * sizeof(index_cache_stream_type))
+        ) {
+            unmap_file(this->cache_data, this->cache_length);
+            return false;
+        }
 
-    const std::vector<frame_type>& get_frames(size_t stream_index) const {
-        return this->streams[stream_index].frames;
-    }
+        this->frame_lookups.assign(this->streams.size(), {});
+        for (size_t stream = 0; stream < this->streams.size(); ++stream) {
+            index_cache_stream_type cache_stream;
+            copy_bytes(&this->cache_data[sizeof(index_cache_header_type) + stream * sizeof(index_cache_stream_type)], &cache_stream, sizeof(index_cache_stream_type));
+
+            // The copy of the codec configuration must match the file.
+            const strf_vids_type* strf_vids = this->streams[stream].strf_vids;
+            bool valid = (cache_stream.strf_vids_length == ((strf_vids != nullptr) ? strf_vids->header_size : 0));
+            valid = valid && (cache_stream.strf_vids_offset <= this->cache_length) && (cache_stream.strf_vids_length <= this->cache_length - cache_stream.strf_vids_offset);
+            for (unsigned long long int byte = 0; valid && (byte < cache_stream.strf_vids_length); ++byte) {
+                valid = (this->cache_data[cache_stream.strf_vids_offset + byte] == reinterpret_cast<const unsigned char*>(strf_vids)[byte]);
+            }
+            valid = valid && (cache_stream.frames_offset <= this->cache_length) && (cache_stream.frame_count <= (this->cache_length - cache_stream.frames_offset) / sizeof(index_cache_frame_type));
+            if (!valid) {
+                this->frame_lookups.clear();
+                unmap_file(this->cache_data, this->cache_length);
+                return false;
+            }
 
-public:
-    constexpr static unsigned int fourcc(const char* data) {
-        return  (static_cast<unsigned int>(data[3]) << 24) |
-                (static_cast<unsigned int>(data[2]) << 16) |
-                (static_cast<unsigned int>(data[1]) <<  8) |
-                (static_cast<unsigned int>(data[0]) <<  0);
+            this->frame_lookups[stream].cache_frames = &this->cache_data[cache_stream.frames_offset];
+            this->frame_lookups[stream].frame_count = cache_stream.frame_count;
+        }
+        this->lookup = lookup_type::cache;
+
+        if (!load_frames) {
+            return true;
+        }
+
+        // Copy the frames out so the cache can be released.
+        bool loaded = true;
+        for (size_t stream = 0; loaded && (stream < this->streams.size()); ++stream) {
+            std::vector<frame_type>& frames = this->streams[stream].frames;
+            frames.resize(static_cast<size_t>(this->frame_lookups[stream].frame_count));
+            for (size_t frame = 0; loaded && (frame < frames.size()); ++frame) {
+                loaded = get_frame(stream, frame, frames[frame]);
+            }
+        }
+        if (!loaded) {
+            for (stream_type& stream : this->streams) {
+                stream.frames.clear();
+            }
+        }
+        this->lookup = lookup_type::frames;
+        this->frame_lookups.clear();
+        unmap_file(this->cache_data, this->cache_length);
+        return loaded;
     }
 
-private:
-    constexpr static void copy_bytes(const void* source, void* destination, unsigned int length) {
-        const unsigned char* data_source = static_cast<const unsigned char*>(source);
-        unsigned char* data_destination = static_cast<unsigned char*>(destination);
-        while (length--) {
-            *data_destination++ = *data_source++;
+    // Write the frames found to a sidecar index cache, through a temporary file that replaces any existing cache.
+    bool write_index_cache(const char* path, unsigned long long int file_time) const {
+        std::vector<unsigned char> cache;
+        std::vector<index_cache_stream_type> cache_streams(this->streams.size());
+        unsigned long long int cache_length = sizeof(index_cache_header_type) + this->streams.size() * sizeof(index_cache_stream_type);
+        for (size_t stream = 0; stream < this->streams.size(); ++stream) {
+            const strf_vids_type* strf_vids = this->streams[stream].strf_vids;
+            cache_streams[stream].strf_vids_offset = cache_length;
+            cache_streams[stream].strf_vids_length = (strf_vids != nullptr) ? strf_vids->header_size : 0;
+            cache_length += cache_streams[stream].strf_vids_length;
+            cache_streams[stream].frame_count = this->get_frame_count(stream);
+            cache_streams[stream].frames_offset = cache_length;
+            cache_length += cache_streams[stream].frame_count * sizeof(index_cache_frame_type);
+        }
+        cache.resize(static_cast<size_t>(cache_length));
+
+        index_cache_header_type header = {};
+        header.identifier = fourcc("AVIc");
+        header.version = index_cache_version;
+        header.file_length = this->file_length;
+        header.file_time = file_time;
+        header.header_hash = hash_headers();
+        header.stream_count = static_cast<unsigned int>(this->streams.size());
+        copy_bytes(&header, &cache[0], sizeof(index_cache_header_type));
+        for (size_t stream = 0; stream < this->streams.size(); ++stream) {
+            const index_cache_stream_type& cache_stream = cache_streams[stream];
+            copy_bytes(&cache_stream, &cache[sizeof(index_cache_header_type) + stream * sizeof(index_cache_stream_type)], sizeof(index_cache_stream_type));
+            if (cache_stream.strf_vids_length > 0) {
+                copy_bytes(this->streams[stream].strf_vids, &cache[static_cast<size_t>(cache_stream.strf_vids_offset)], static_cast<unsigned int>(cache_stream.strf_vids_length));
+            }
+            for (unsigned long long int frame_number = 0; frame_number < cache_stream.frame_count; ++frame_number) {
+                frame_type frame;
+                if (!this->get_frame(stream, frame_number, frame)) {
+                    return false;
+                }
+                index_cache_frame_type cache_frame;
+                cache_frame.offset = static_cast<unsigned long long int>(frame.data - this->file_data);
+                cache_frame.length = static_cast<unsigned int>(frame.length);
+                copy_bytes(&cache_frame, &cache[static_cast<size_t>(cache_stream.frames_offset + frame_number * sizeof(index_cache_frame_type))], sizeof(index_cache_frame_type));
+            }
+        }
+
+        std::vector<char> temporary_path(path, path + std::strlen(path));
+        const char* suffix = ".tmp";
+        temporary_path.insert(temporary_path.end(), suffix, suffix + 5);
+        std::FILE* file = std::fopen(temporary_path.data(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        const bool written = (std::fwrite(cache.data(), 1, cache.size(), file) == cache.size());
+        if ((std::fclose(file) != 0) || (!written)) {
+            std::remove(temporary_path.data());
+            return false;
         }
+#if defined(_WIN32)
+        const bool replaced = (MoveFileExA(temporary_path.data(), path, MOVEFILE_REPLACE_EXISTING) != 0);
+#else
+        const bool replaced = (std::rename(temporary_path.data(), path) == 0);
+#endif
+        if (!replaced) {
+            std::remove(temporary_path.data());
+        }
+        return replaced;
     }
 
 private:
-    static bool parse_chunks(const unsigned char* data, unsigned long long int length, chunk_node_type& node) {
+    // Add a chunk to the chunk table, followed by its children when it is a RIFF or LIST chunk.
+    // LIST[movi] chunks are not descended into, frames are found from the indexes or by scanning the list only when there are none.
+    bool parse_chunks(const unsigned char* data, unsigned long long int length) {
         // Extract chunk header data.
         if (length < 8) {
             return false;
         }
-        node.chunk = reinterpret_cast<const chunk_type*>(&data[0]);
-        if (node.chunk->length + 8 > length) {
+        const size_t entry = this->chunks.size();
+        const chunk_type* chunk = reinterpret_cast<const chunk_type*>(&data[0]);
+        this->chunks.push_back({ chunk, 0, entry + 1 });
+        if (8ull + chunk->length > length) {
             std::fprintf(stderr, "Error: Chunk length is greater than remaining length.\n");
             return false;
         }
         const unsigned char* chunk_data = &data[8];
         // If chunk is a collection/list, recursively parse more.
-        if ((node.chunk->identifier == fourcc("RIFF")) || (node.chunk->identifier == fourcc("LIST"))) {
-            if ((node.chunk->length < 4) || (length < 12)) {
+        if ((chunk->identifier == fourcc("RIFF")) || (chunk->identifier == fourcc("LIST"))) {
+            if ((chunk->length < 4) || (length < 12)) {
                 std::fprintf(stderr, "Error: Chunk length is too short.\n");
                 return false;
             }
-            copy_bytes(&chunk_data[0], &node.form, 4);
-            unsigned int index = 4;
-            while ((index < node.chunk->length) && (index + 8 < length)) {
-                node.children.push_back({});
-                const chunk_node_type& child = node.children.back();
-                if (!parse_chunks(&reinterpret_cast<const unsigned char*>(node.chunk)[sizeof(chunk_type) + index], node.chunk->length - 4, node.children.back())) {
+            unsigned int form = 0;
+            copy_bytes(&chunk_data[0], &form, 4);
+            this->chunks[entry].form = form;
+            if ((chunk->identifier == fourcc("LIST")) && (form == fourcc("movi"))) {
+                return true;
+            }
+            unsigned long long int index = 4;
+            while ((index < chunk->length) && (index + 8 < length)) {
+                const size_t child = this->chunks.size();
+                if (!parse_chunks(&chunk_data[index], chunk->length - index)) {
                     std::fprintf(stderr, "Error: Failed to parse chunk.\n");
                     return false;
                 }
-                index += 8 + child.chunk->length + (child.chunk->length % 2);
+                index += 8ull + this->chunks[child].chunk->length + (this->chunks[child].chunk->length % 2);
             }
-            return (index == node.chunk->length);
+            this->chunks[entry].end = this->chunks.size();
+            return (index == chunk->length);
         }
         return true;
     }
 
+    // Index of the first child of a chunk with the identifier, and form when not zero, or zero when there is none.
+    size_t find_chunk(size_t parent, unsigned int identifier, unsigned int form) const {
+        for (size_t child = parent + 1; child < this->chunks[parent].end; child = this->chunks[child].end) {
+            if ((this->chunks[child].chunk->identifier == identifier) && ((form == 0) || (this->chunks[child].form == form))) {
+                return child;
+            }
+        }
+        return 0;
+    }
+
     bool decode_avi_header() {
         // RIFF[AVI ]->LIST[hdrl]->avih
 
         // Start at the root chunk.
-        const chunk_node_type* node = &this->root_chunk_node;
+        size_t node = 0;
 
         // Validate.
-        if (node->chunk->identifier != fourcc("RIFF")) {
+        if (this->chunks[node].chunk->identifier != fourcc("RIFF")) {
             std::fprintf(stderr, "Error: Failed to decode avi header. First chunk is not 'RIFF'.\n");
             return false;
         }
-        if (node->form != fourcc("AVI ")) {
+        if (this->chunks[node].form != fourcc("AVI ")) {
             std::fprintf(stderr, "Error: Failed to decode avi header. 'RIFF' chunk is not of 'AVI ' form.\n");
             return false;
         }
 
         // Search for the LIST[hdrl] chunk.
-        for (const chunk_node_type& child : node->children) {
-            if (child.chunk->identifier == fourcc("LIST")) {
-                if (child.form == fourcc("hdrl")) {
-                    node = &child;
-                    break;
-                }
-            }
-        }
+        node = find_chunk(node, fourcc("LIST"), fourcc("hdrl"));
 
         // Validate.
-        if ((node->chunk->identifier != fourcc("LIST")) || (node->form != fourcc("hdrl"))) {
+        if (node == 0) {
             std::fprintf(stderr, "Error: Failed to decode avi header. 'RIFF[AVI ]' chunk does not contain a 'LIST[hdrl]' chunk.\n");
             return false;
         }
 
         // Search for the avih chunk.
-        for (const chunk_node_type& child : node->children) {
-            if (child.chunk->identifier == fourcc("avih")) {
-                node = &child;
-                break;
-            }
-        }
+        node = find_chunk(node, fourcc("avih"), 0);
 
-        if (node->chunk->identifier != fourcc("avih")) {
+        if (node == 0) {
             std::fprintf(stderr, "Error: Failed to decode avi header. 'RIFF[AVI ]->LIST[hdrl]' chunk does not contain an 'avih' chunk.\n");
             return false;
         }
 
-        if (node->chunk->length != sizeof(avih_type)) {
+        if (this->chunks[node].chunk->length != sizeof(avih_type)) {
             std::fprintf(stderr, "Error: Failed to decode avi header. 'RIFF[AVI ]->LIST[hdrl]->avih' chunk is not the correct size.\n");
             return false;
         }
 
-        this->avih = reinterpret_cast<const avih_type*>(&reinterpret_cast<const unsigned char*>(node->chunk)[sizeof(chunk_type)]);
+        this->avih = reinterpret_cast<const avih_type*>(&reinterpret_cast<const unsigned char*>(this->chunks[node].chunk)[sizeof(chunk_type)]);
 
         return true;
     }
@@ -475,42 +1675,36 @@ private:
         // RIFF[AVI ]->LIST[hdrl]->LIST[strl]->strh
 
         // Start at the root chunk.
-        const chunk_node_type* node = &this->root_chunk_node;
+        size_t node = 0;
 
         // Validate.
-        if (node->chunk->identifier != fourcc("RIFF")) {
+        if (this->chunks[node].chunk->identifier != fourcc("RIFF")) {
             std::fprintf(stderr, "Error: Failed to decode avi headers. First chunk is not 'RIFF'.\n");
             return false;
         }
-        if (node->form != fourcc("AVI ")) {
+        if (this->chunks[node].form != fourcc("AVI ")) {
             std::fprintf(stderr, "Error: Failed to decode avi headers. 'RIFF' chunk is not of 'AVI ' form.\n");
             return false;
         }
 
         // Search for the LIST[hdrl] chunk.
-        for (const chunk_node_type& child : node->children) {
-            if (child.chunk->identifier == fourcc("LIST")) {
-                if (child.form == fourcc("hdrl")) {
-                    node = &child;
-                    break;
-                }
-            }
-        }
+        node = find_chunk(node, fourcc("LIST"), fourcc("hdrl"));
 
         // Validate.
-        if ((node->chunk->identifier != fourcc("LIST")) || (node->form != fourcc("hdrl"))) {
+        if (node == 0) {
             std::fprintf(stderr, "Error: Failed to decode avi headers. 'RIFF[AVI ]' chunk does not contain a 'LIST[hdrl]' chunk.\n");
             return false;
         }
 
         // Process all the LIST[strl]->strh chunks.
         bool found_strl = false;
-        for (const chunk_node_type& child : node->children) {
+        for (size_t index_child = node + 1; index_child < this->chunks[node].end; index_child = this->chunks[index_child].end) {
+            const chunk_entry_type& child = this->chunks[index_child];
             if (child.chunk->identifier == fourcc("LIST")) {
                 if (child.form == fourcc("strl")) {
                     found_strl = true;
 
-                    const chunk_node_type* chunk_strl = &child;
+                    const size_t chunk_strl = index_child;
                     std::vector<const strh_type*> strhs;
                     std::vector<const void*> strfs;
                     std::vector<const strf_auds_type*> strf_audss;
@@ -519,7 +1713,9 @@ private:
                     // Search for the strh chunk.
                     bool found_strh = false;
                     bool found_strf = false;
-                    for (const chunk_node_type& strl_child : chunk_strl->children) {
+                    const chunk_type* chunk_super_index = nullptr;
+                    for (size_t index_strl_child = chunk_strl + 1; index_strl_child < this->chunks[chunk_strl].end; index_strl_child = this->chunks[index_strl_child].end) {
+                        const chunk_entry_type& strl_child = this->chunks[index_strl_child];
                         if (strl_child.chunk->identifier == fourcc("strh")) {
                             if (found_strh) {
                                 std::fprintf(stderr, "Error: Failed to decode avi headers. 'RIFF[AVI ]->LIST[hdrl]->LIST[strl]' chunk contains multiple 'strh' chunks.\n");
@@ -535,6 +1731,10 @@ private:
                             strhs.push_back(reinterpret_cast<const strh_type*>(&reinterpret_cast<const unsigned char*>(strl_child.chunk)[sizeof(chunk_type)]));
                         }
 
+                        if (strl_child.chunk->identifier == fourcc("indx")) {
+                            chunk_super_index = strl_child.chunk;
+                        }
+
                         if (strl_child.chunk->identifier == fourcc("strf")) {
                             if (found_strf) {
                                 std::fprintf(stderr, "Error: Failed to decode avi headers. 'RIFF[AVI ]->LIST[hdrl]->LIST[strl]' chunk contains multiple 'strf' chunks.\n");
@@ -595,6 +1795,7 @@ private:
                     if (!strf_audss.empty()) {
                         this->streams.back().strf_auds = strf_audss.back();
                     }
+                    this->stream_super_indexes.push_back(chunk_super_index);
                 }
             }
         }
@@ -612,139 +1813,78 @@ private:
         // RIFF[AVI ]->idx1
 
         // Start at the root chunk.
-        const chunk_node_type* node = &this->root_chunk_node;
+        size_t node = 0;
 
         // Validate.
-        if (node->chunk->identifier != fourcc("RIFF")) {
+        if (this->chunks[node].chunk->identifier != fourcc("RIFF")) {
             std::fprintf(stderr, "Error: Failed to decode avi streams. First chunk is not 'RIFF'.\n");
             return false;
         }
-        if (node->form != fourcc("AVI ")) {
+        if (this->chunks[node].form != fourcc("AVI ")) {
             std::fprintf(stderr, "Error: Failed to decode avi streams. 'RIFF' chunk is not of 'AVI ' form.\n");
             return false;
         }
 
         // Search for the LIST[movi] chunk.
-        for (const chunk_node_type& child : node->children) {
-            if (child.chunk->identifier == fourcc("LIST")) {
-                if (child.form == fourcc("movi")) {
-                    node = &child;
-                    break;
-                }
-            }
-        }
+        node = find_chunk(node, fourcc("LIST"), fourcc("movi"));
 
         // Validate.
-        if ((node->chunk->identifier != fourcc("LIST")) || (node->form != fourcc("movi"))) {
+        if (node == 0) {
             std::fprintf(stderr, "Error: Failed to decode avi headers. 'RIFF[AVI ]' chunk does not contain a 'LIST[movi]' chunk.\n");
             return false;
         }
+        const chunk_type* chunk_movi = this->chunks[node].chunk;
 
         // Search for the idx1 chunk.
-        const chunk_node_type* chunk_index = &this->root_chunk_node;
-        for (const chunk_node_type& child : chunk_index->children) {
-            if (child.chunk->identifier == fourcc("idx1")) {
-                chunk_index = &child;
-                break;
-            }
-        }
+        const size_t chunk_index_entry = find_chunk(0, fourcc("idx1"), 0);
 
-        // Handy conversion function for stream number.
-        constexpr static const auto hex_to_dec = [](unsigned char character)->int{
-            if (('0' <= character) && (character <= '9')) {
-                return (character - '0');
-            }
-            if (('a' <= character) && (character <= 'f')) {
-                return 10 + (character - 'a');
-            }
-            if (('A' <= character) && (character <= 'F')) {
-                return 10 + (character - 'A');
-            }
-            return -1;
-        };
+        // Prefer the OpenDML indexes, they cover every RIFF chunk.
+        bool has_super_indexes = !this->stream_super_indexes.empty();
+        for (const chunk_type* super_index : this->stream_super_indexes) {
+            has_super_indexes = has_super_indexes && (super_index != nullptr);
+        }
+        if (has_super_indexes) {
+            return decode_super_indexes();
+        }
 
         // Validate.
-        if (chunk_index->chunk->identifier != fourcc("idx1")) {
+        if (chunk_index_entry == 0) {
             // No index found. Just load chunks in the order they come.
-
-            // RIFF[AVI ]->LIST[movi]->frame
-            // RIFF[AVI ]->LIST[movi]->LIST[rec ]->frame
-            // Where frame is one of:
-            // - XXdb Uncompressed video frame
-            // - XXdc Compressed video frame
-            // - XXpc Palette change
-            // - XXwb Audio data
-            // Where XX is the stream number/index.
-            // Where XX starts at zero and is the same order as strh/strf headers are written.
-
-            // Process all the LIST[movi] chunks.
-            for (const chunk_node_type& child : node->children) {
-                if (child.chunk->identifier == fourcc("LIST")) {
-                    if (child.form == fourcc("rec ")) {
-                        for (const chunk_node_type& chunk_frame : child.children) {
-                            int stream_id = hex_to_dec((chunk_frame.chunk->identifier >> 8) & 0xFF) + hex_to_dec((chunk_frame.chunk->identifier >> 0) & 0xFF) * 16;
-                            if ((stream_id < 0) || (stream_id >= static_cast<int>(this->avih->stream_count))) {
-                                std::fprintf(stderr, "Error: Failed to decode avi streams. 'RIFF[AVI ]->LIST[movi]->LIST[rec ]' contains a chunk with an invalid stream number.\n");
-                                return false;
-                            }
-                            frame_type frame;
-                            frame.data = &reinterpret_cast<const unsigned char*>(chunk_frame.chunk)[sizeof(chunk_type)];
-                            frame.length = chunk_frame.chunk->length;
-                            this->streams[static_cast<size_t>(stream_id)].frames.push_back(frame);
-                        }
-                    }
-                }
-                else {
-                    const chunk_node_type& chunk_frame = child;
-                    int stream_id = hex_to_dec((chunk_frame.chunk->identifier >> 8) & 0xFF) + hex_to_dec((chunk_frame.chunk->identifier >> 0) & 0xFF) * 16;
-                    if ((stream_id < 0) || (stream_id >= static_cast<int>(this->avih->stream_count))) {
-                        std::fprintf(stderr, "Error: Failed to decode avi streams. 'RIFF[AVI ]->LIST[movi]' contains a chunk with an invalid stream number.\n");
-                        return false;
-                    }
-                    frame_type frame;
-                    frame.data = &reinterpret_cast<const unsigned char*>(chunk_frame.chunk)[sizeof(chunk_type)];
-                    frame.length = chunk_frame.chunk->length;
-                    this->streams[static_cast<size_t>(stream_id)].frames.push_back(frame);
-                }
+            if (!decode_list(chunk_movi)) {
+                return false;
             }
-
-            return true;
+            return decode_extended_movis();
         }
+        const chunk_type* chunk_index = this->chunks[chunk_index_entry].chunk;
 
-        if (chunk_index->chunk->length % sizeof(index_type) != 0) {
+        if (chunk_index->length % sizeof(index_type) != 0) {
             std::fprintf(stderr, "Error: Failed to decode avi streams. 'RIFF[AVI ]->idx1' chunk is not a valid size.\n");
             return false;
         }
 
-        for (unsigned int i = 0; i < chunk_index->chunk->length; i += sizeof(index_type)) {
+        for (unsigned int i = 0; i < chunk_index->length; i += sizeof(index_type)) {
             index_type index;
-            copy_bytes(&reinterpret_cast<const unsigned char*>(chunk_index->chunk)[sizeof(chunk_type) + i], &index, sizeof(index_type));
+            copy_bytes(&reinterpret_cast<const unsigned char*>(chunk_index)[sizeof(chunk_type) + i], &index, sizeof(index_type));
 
-            if (index.offset + index.size + 8 > node->chunk->length) {
+            if (8ull + index.offset + index.size > chunk_movi->length) {
                 std::fprintf(stderr, "Error: Failed to decode avi streams. 'RIFF[AVI ]->idx1' chunk index offset is not a valid size.\n");
                 return false;
             }
 
             // Check if the index is pointing at a rec list.
             if (index.flags & 0x00000001) {
-                chunk_node_type chunk_list;
-                parse_chunks(&reinterpret_cast<const unsigned char*>(node->chunk)[sizeof(chunk_type) + index.offset], index.size + 8, chunk_list);
-                if ((chunk_list.chunk->identifier != fourcc("LIST")) || (chunk_list.form != fourcc("rec "))) {
+                const chunk_type* chunk_list = reinterpret_cast<const chunk_type*>(&reinterpret_cast<const unsigned char*>(chunk_movi)[sizeof(chunk_type) + index.offset]);
+                unsigned int form = 0;
+                if ((chunk_list->identifier == fourcc("LIST")) && (chunk_list->length >= 4)) {
+                    copy_bytes(&reinterpret_cast<const unsigned char*>(chunk_list)[sizeof(chunk_type)], &form, 4);
+                }
+                if ((form != fourcc("rec ")) || (chunk_list->length > index.size)) {
                     std::fprintf(stderr, "Error: Failed to decode avi streams. 'RIFF[AVI ]->idx1' chunk index offset does not contain a 'LIST[rec ]' chunk.\n");
                     return false;
                 }
-                for (const chunk_node_type& chunk_frame : chunk_list.children) {
-                    int stream_id = hex_to_dec((chunk_frame.chunk->identifier >> 8) & 0xFF) + hex_to_dec((chunk_frame.chunk->identifier >> 0) & 0xFF) * 16;
-                    if ((stream_id < 0) || (stream_id >= static_cast<int>(this->avih->stream_count))) {
-                        std::fprintf(stderr, "Error: Failed to decode avi streams. 'RIFF[AVI ]->idx1' chunk index offset to 'LIST[rec ]' contains a chunk with an invalid stream number.\n");
-                        return false;
-                    }
-                    frame_type frame;
-                    frame.data = &reinterpret_cast<const unsigned char*>(chunk_frame.chunk)[sizeof(chunk_type)];
-                    frame.length = chunk_frame.chunk->length;
-                    this->streams[static_cast<size_t>(stream_id)].frames.push_back(frame);
+                if (!decode_list(chunk_list)) {
+                    return false;
                 }
-                return true;
             }
             else {
                 int stream_id = hex_to_dec((index.chunk_id >> 8) & 0xFF) + hex_to_dec((index.chunk_id >> 0) & 0xFF) * 16;
@@ -753,12 +1893,251 @@ private:
                     return false;
                 }
                 frame_type frame;
-                frame.data = &reinterpret_cast<const unsigned char*>(node->chunk)[sizeof(chunk_type) + index.offset + sizeof(chunk_type)];
+                frame.data = &reinterpret_cast<const unsigned char*>(chunk_movi)[sizeof(chunk_type) + index.offset + sizeof(chunk_type)];
                 frame.length = index.size;
                 this->streams[static_cast<size_t>(stream_id)].frames.push_back(frame);
             }
         }
 
+        // The idx1 chunk only covers the RIFF[AVI ] chunk.
+        return decode_extended_movis();
+    }
+
+    bool decode_list(const chunk_type* list) {
+        // LIST[movi]->frame
+        // LIST[movi]->LIST[rec ]->frame
+        // Where frame is one of:
+        // - XXdb Uncompressed video frame
+        // - XXdc Compressed video frame
+        // - XXpc Palette change
+        // - XXwb Audio data
+        // Where XX is the stream number/index.
+        // Where XX starts at zero and is the same order as strh/strf headers are written.
+        // Other chunks, such as JUNK or ix## indexes, are skipped.
+        // The list is scanned in place, nothing is added to the chunk table.
+        const unsigned char* list_data = &reinterpret_cast<const unsigned char*>(list)[sizeof(chunk_type)];
+        unsigned long long int index = 4;
+        while (index + sizeof(chunk_type) <= list->length) {
+            const chunk_type* chunk = reinterpret_cast<const chunk_type*>(&list_data[index]);
+            if (chunk->length > list->length - index - sizeof(chunk_type)) {
+                std::fprintf(stderr, "Error: Failed to decode avi streams. 'LIST' contains a chunk with a length greater than the remaining length.\n");
+                return false;
+            }
+            if (chunk->identifier == fourcc("LIST")) {
+                unsigned int form = 0;
+                if (chunk->length >= 4) {
+                    copy_bytes(&list_data[index + sizeof(chunk_type)], &form, 4);
+                }
+                if ((form == fourcc("rec ")) && (!decode_list(chunk))) {
+                    return false;
+                }
+            }
+            else if (is_stream_chunk(chunk->identifier)) {
+                int stream_id = hex_to_dec((chunk->identifier >> 8) & 0xFF) + hex_to_dec((chunk->identifier >> 0) & 0xFF) * 16;
+                if ((stream_id < 0) || (stream_id >= static_cast<int>(this->avih->stream_count))) {
+                    std::fprintf(stderr, "Error: Failed to decode avi streams. 'LIST[movi]' contains a chunk with an invalid stream number.\n");
+                    return false;
+                }
+                frame_type frame;
+                frame.data = &list_data[index + sizeof(chunk_type)];
+                frame.length = chunk->length;
+                this->streams[static_cast<size_t>(stream_id)].frames.push_back(frame);
+            }
+            index += 8ull + chunk->length + (chunk->length % 2);
+        }
+        return true;
+    }
+
+    bool decode_extended_movis() {
+        // RIFF[AVIX]->LIST[movi]
+        for (size_t riff = 1; riff < this->riff_chunks.size(); ++riff) {
+            const size_t node = this->riff_chunks[riff];
+            for (size_t child = node + 1; child < this->chunks[node].end; child = this->chunks[child].end) {
+                if ((this->chunks[child].chunk->identifier == fourcc("LIST")) && (this->chunks[child].form == fourcc("movi"))) {
+                    if (!decode_list(this->chunks[child].chunk)) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    bool get_frame_rate(size_t stream_index, unsigned long long int& rate, unsigned long long int& scale) const {
+        // rate / scale == frames / second, falling back to the main header for streams without a rate.
+        rate = this->streams[stream_index].strh->rate;
+        scale = this->streams[stream_index].strh->scale;
+        if ((rate == 0) || (scale == 0)) {
+            rate = 1000000;
+            scale = this->avih->microseconds_per_frame;
+        }
+        return (scale != 0);
+    }
+
+    bool decode_lookups() {
+        // Prefer the OpenDML indexes, they cover every RIFF chunk.
+        bool has_super_indexes = !this->stream_super_indexes.empty();
+        for (const chunk_type* super_index : this->stream_super_indexes) {
+            has_super_indexes = has_super_indexes && (super_index != nullptr);
+        }
+        if (has_super_indexes) {
+            this->frame_lookups.assign(this->streams.size(), {});
+            for (size_t stream = 0; stream < this->streams.size(); ++stream) {
+                frame_lookup_type& frame_lookup = this->frame_lookups[stream];
+                if (!find_standard_indexes(stream, frame_lookup.standard_indexes)) {
+                    return false;
+                }
+                frame_lookup.frame_count = 0;
+                for (const chunk_type* chunk_standard_index : frame_lookup.standard_indexes) {
+                    standard_index_type standard_index;
+                    if (!read_standard_index(chunk_standard_index, standard_index)) {
+                        return false;
+                    }
+                    frame_lookup.first_frames.push_back(frame_lookup.frame_count);
+                    frame_lookup.frame_count += standard_index.entries_in_use;
+                }
+            }
+            this->lookup = lookup_type::standard_indexes;
+            return true;
+        }
+
+        // The idx1 index is only used when it covers the whole file and does not point at rec lists.
+        const size_t chunk_movi = find_chunk(0, fourcc("LIST"), fourcc("movi"));
+        const size_t chunk_index = find_chunk(0, fourcc("idx1"), 0);
+        if ((chunk_movi == 0) || (chunk_index == 0) || (this->riff_chunks.size() > 1) || (this->chunks[chunk_index].chunk->length % sizeof(index_type) != 0)) {
+            return true;
+        }
+        const unsigned char* index_data = &reinterpret_cast<const unsigned char*>(this->chunks[chunk_index].chunk)[sizeof(chunk_type)];
+        const unsigned int index_count = this->chunks[chunk_index].chunk->length / sizeof(index_type);
+
+        // Every entry is read once to count and check the frames, but only a sparse set of positions is kept to pick out the frames of each stream when there is more than one.
+        this->frame_lookups.assign(this->streams.size(), {});
+        for (unsigned int position = 0; position < index_count; ++position) {
+            index_type index;
+            copy_bytes(&index_data[position * sizeof(index_type)], &index, sizeof(index_type));
+            const int stream_id = hex_to_dec((index.chunk_id >> 8) & 0xFF) + hex_to_dec((index.chunk_id >> 0) & 0xFF) * 16;
+            if ((index.flags & 0x00000001) || (!is_stream_chunk(index.chunk_id)) || (stream_id >= static_cast<int>(this->streams.size()))) {
+                this->frame_lookups.clear();
+                return true;
+            }
+            frame_lookup_type& frame_lookup = this->frame_lookups[static_cast<size_t>(stream_id)];
+            if ((this->streams.size() > 1) && (frame_lookup.frame_count % index_checkpoint_interval == 0)) {
+                frame_lookup.index_checkpoints.push_back(position);
+            }
+            frame_lookup.frame_count += 1;
+        }
+        this->lookup_index = this->chunks[chunk_index].chunk;
+        this->lookup_movi = this->chunks[chunk_movi].chunk;
+        this->lookup = lookup_type::index;
+        return true;
+    }
+
+    bool decode_super_indexes() {
+        // RIFF[AVI ]->LIST[hdrl]->LIST[strl]->indx->ix##
+        std::vector<const chunk_type*> standard_indexes;
+        for (size_t stream = 0; stream < this->streams.size(); ++stream) {
+            if (!find_standard_indexes(stream, standard_indexes)) {
+                return false;
+            }
+            for (const chunk_type* chunk_standard_index : standard_indexes) {
+                standard_index_type standard_index;
+                if (!read_standard_index(chunk_standard_index, standard_index)) {
+                    return false;
+                }
+                this->streams[stream].frames.reserve(this->streams[stream].frames.size() + standard_index.entries_in_use);
+                for (unsigned int entry = 0; entry < standard_index.entries_in_use; ++entry) {
+                    frame_type frame;
+                    if (!read_standard_index_entry(chunk_standard_index, standard_index, entry, frame)) {
+                        return false;
+                    }
+                    this->streams[stream].frames.push_back(frame);
+                }
+            }
+        }
+        return true;
+    }
+
+    bool find_standard_indexes(size_t stream, std::vector<const chunk_type*>& standard_indexes) const {
+        standard_indexes.clear();
+
+        const chunk_type* chunk_super_index = this->stream_super_indexes[stream];
+        const unsigned char* super_index_data = &reinterpret_cast<const unsigned char*>(chunk_super_index)[sizeof(chunk_type)];
+
+        if (chunk_super_index->length < sizeof(super_index_type)) {
+            std::fprintf(stderr, "Error: Failed to decode avi streams. 'indx' chunk is not a valid size.\n");
+            return false;
+        }
+        super_index_type super_index;
+        copy_bytes(super_index_data, &super_index, sizeof(super_index_type));
+
+        // Some writers store a standard index directly in the indx chunk.
+        if (super_index.index_type == 0x01) {
+            standard_indexes.push_back(chunk_super_index);
+            return true;
+        }
+
+        if ((super_index.index_type != 0x00) || (super_index.longs_per_entry != sizeof(super_index_entry_type) / 4)) {
+            std::fprintf(stderr, "Error: Failed to decode avi streams. 'indx' chunk is not a supported index type.\n");
+            return false;
+        }
+        if (static_cast<unsigned long long int>(super_index.entries_in_use) * sizeof(super_index_entry_type) > chunk_super_index->length - sizeof(super_index_type)) {
+            std::fprintf(stderr, "Error: Failed to decode avi streams. 'indx' chunk has more entries than fit in the chunk.\n");
+            return false;
+        }
+
+        for (unsigned int entry = 0; entry < super_index.entries_in_use; ++entry) {
+            super_index_entry_type super_index_entry;
+            copy_bytes(&super_index_data[sizeof(super_index_type) + entry * sizeof(super_index_entry_type)], &super_index_entry, sizeof(super_index_entry_type));
+
+            if ((super_index_entry.offset > this->file_length) || (this->file_length - super_index_entry.offset < sizeof(chunk_type))) {
+                std::fprintf(stderr, "Error: Failed to decode avi streams. 'indx' chunk entry offset is outside the file.\n");
+                return false;
+            }
+            const chunk_type* chunk_standard_index = reinterpret_cast<const chunk_type*>(&this->file_data[super_index_entry.offset]);
+            if (this->file_length - super_index_entry.offset - sizeof(chunk_type) < chunk_standard_index->length) {
+                std::fprintf(stderr, "Error: Failed to decode avi streams. 'ix##' chunk length is greater than remaining length.\n");
+                return false;
+            }
+            standard_indexes.push_back(chunk_standard_index);
+        }
+        return true;
+    }
+
+    // ix## chunks list the chunks of a stream relative to a base offset, so every frame is found without a scan.
+    static bool read_standard_index(const chunk_type* chunk_standard_index, standard_index_type& standard_index) {
+        if (chunk_standard_index->length < sizeof(standard_index_type)) {
+            std::fprintf(stderr, "Error: Failed to decode avi streams. 'ix##' chunk is not a valid size.\n");
+            return false;
+        }
+        copy_bytes(&reinterpret_cast<const unsigned char*>(chunk_standard_index)[sizeof(chunk_type)], &standard_index, sizeof(standard_index_type));
+
+        if ((standard_index.index_type != 0x01) || (standard_index.index_sub_type != 0x00) || (standard_index.longs_per_entry != sizeof(standard_index_entry_type) / 4)) {
+            std::fprintf(stderr, "Error: Failed to decode avi streams. 'ix##' chunk is not a supported index type.\n");
+            return false;
+        }
+        if (static_cast<unsigned long long int>(standard_index.entries_in_use) * sizeof(standard_index_entry_type) > chunk_standard_index->length - sizeof(standard_index_type)) {
+            std::fprintf(stderr, "Error: Failed to decode avi streams. 'ix##' chunk has more entries than fit in the chunk.\n");
+            return false;
+        }
+        return true;
+    }
+
+    bool read_standard_index_entry(const chunk_type* chunk_standard_index, const standard_index_type& standard_index, unsigned int entry, frame_type& frame) const {
+        standard_index_entry_type standard_index_entry;
+        copy_bytes(&reinterpret_cast<const unsigned char*>(chunk_standard_index)[sizeof(chunk_type) + sizeof(standard_index_type) + entry * sizeof(standard_index_entry_type)], &standard_index_entry, sizeof(standard_index_entry_type));
+
+        const unsigned long long int offset = standard_index.base_offset + standard_index_entry.offset;
+        const unsigned long long int size = standard_index_entry.size & 0x7FFFFFFF;
+        if ((standard_index.base_offset > this->file_length) || (offset > this->file_length) || (this->file_length - offset < size)) {
+            std::fprintf(stderr, "Error: Failed to decode avi streams. 'ix##' chunk entry is outside the file.\n");
+            return false;
+        }
+        frame.data = &this->file_data[offset];
+        frame.length = size;
         return true;
     }
+
+    constexpr static bool is_stream_chunk(unsigned int identifier) {
+        return (hex_to_dec((identifier >> 0) & 0xFF) >= 0) && (hex_to_dec((identifier >> 8) & 0xFF) >= 0);
+    }
 };
@@ -0,0 +1,412 @@
+#pragma once
+
+#include "avi.hpp"
+#include "huffyuv.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+    #if !defined(NOMINMAX)
+        #define NOMINMAX
+    #endif
+    #if !defined(WIN32_LEAN_AND_MEAN)
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <dirent.h>
+    #include <sys/stat.h>
+#endif
+
+// Catalogues the video streams of every avi in a collection of files and directories without reading any frame data.
+// Only the start of each file is read with pread, enough for the LIST[hdrl] chunk, which is parsed alone with its indexes hidden.
+// Each HFYU stream is checked by constructing a huffyuv from its strf_vids header, which validates the format, predictor, interlacing and tables.
+// Directories are walked and files read by a pool of threads sharing one queue, so the latency of each read overlaps with the others.
+class avi_catalog final {
+public:
+    // Bytes read from the start of each file, enough for the headers of almost every file, longer header lists take a second read.
+    constexpr static const unsigned long long int header_read_size = 0x00010000;
+
+    struct stream_entry_type {
+        size_t stream;
+        unsigned int compression_identifier;
+        int width;
+        int height;
+        unsigned short bit_count;
+        unsigned int frame_count;
+        unsigned int rate;
+        unsigned int scale;
+        // HFYU streams, and whether the huffyuv configuration of the stream is valid.
+        bool huffyuv;
+        bool valid;
+        huffyuv::format_type format;
+        huffyuv::predictor_type predictor;
+        bool interlaced;
+        bool decorrelated;
+    };
+
+    struct entry_type {
+        std::string path;
+        // The headers were read and parsed, the video streams are only set when they were.
+        bool parsed;
+        std::vector<stream_entry_type> streams;
+    };
+
+private:
+    struct pending_type {
+        std::string path;
+        bool directory;
+    };
+
+private:
+    std::vector<entry_type> entries;
+    // Everything below is shared with the scanning threads.
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<pending_type> pending;
+    // Threads working on a path taken from the queue, the scan is complete once the queue is empty and none are.
+    unsigned int busy;
+
+public:
+    avi_catalog()
+        : entries()
+        , mutex()
+        , condition()
+        , pending()
+        , busy(0) {
+    }
+
+    avi_catalog(const avi_catalog&) = delete;
+    avi_catalog& operator=(const avi_catalog&) = delete;
+
+public:
+    // Catalogue the files given and every file with an avi extension in the directories given and their subdirectories.
+    // A thread count of zero uses one thread per hardware thread, entries are sorted by path once every thread has finished.
+    // Files that cannot be parsed are still catalogued, only paths that do not exist fail the scan.
+    bool scan(const std::vector<std::string>& paths, unsigned int thread_count = 0) {
+        this->entries.clear();
+        this->pending.clear();
+        this->busy = 0;
+        for (const std::string& path : paths) {
+            bool directory = false;
+            if (!is_directory(path, directory)) {
+                std::fprintf(stderr, "Error: Failed to find '%s'.\n", path.c_str());
+                return false;
+            }
+            this->pending.push_back({ path, directory });
+        }
+
+        if (thread_count == 0) {
+            thread_count = std::thread::hardware_concurrency();
+            thread_count = (thread_count > 0) ? thread_count : 1;
+        }
+        std::vector<std::thread> threads;
+        for (unsigned int index = 1; index < thread_count; ++index) {
+            threads.emplace_back(&avi_catalog::work, this);
+        }
+        this->work();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        std::sort(this->entries.begin(), this->entries.end(), [](const entry_type& lhs, const entry_type& rhs) {
+            return lhs.path < rhs.path;
+        });
+        return true;
+    }
+
+    const std::vector<entry_type>& get_entries() const {
+        return this->entries;
+    }
+
+    // Write a tab separated line for each video stream, and for each file without any, followed by a summary.
+    // Columns: path, stream, compression, dimensions, bits per pixel, frames, frame rate, status and, for valid HFYU streams, the configuration.
+    bool write_report(std::FILE* output) const {
+        unsigned long long int unparsed = 0;
+        unsigned long long int huffyuv_streams = 0;
+        unsigned long long int invalid_streams = 0;
+        for (const entry_type& entry : this->entries) {
+            if (!entry.parsed) {
+                unparsed += 1;
+                std::fprintf(output, "%s\t-\t-\t-\t-\t-\t-\tunreadable\n", entry.path.c_str());
+                continue;
+            }
+            if (entry.streams.empty()) {
+                std::fprintf(output, "%s\t-\t-\t-\t-\t-\t-\tno-video\n", entry.path.c_str());
+                continue;
+            }
+            for (const stream_entry_type& stream : entry.streams) {
+                char compression[5] = {};
+                std::memcpy(compression, &stream.compression_identifier, 4);
+                for (int index = 0; index < 4; ++index) {
+                    compression[index] = ((compression[index] >= 0x20) && (compression[index] < 0x7F)) ? compression[index] : '.';
+                }
+                std::fprintf(output, "%s\t%zu\t%s\t%dx%d\t%u\t%u\t%.3f\t",
+                    entry.path.c_str(),
+                    stream.stream,
+                    compression,
+                    stream.width,
+                    stream.height,
+                    static_cast<unsigned int>(stream.bit_count),
+                    stream.frame_count,
+                    (stream.scale > 0) ? static_cast<double>(stream.rate) / stream.scale : 0.0
+                );
+                if (!stream.huffyuv) {
+                    std::fprintf(output, "other\n");
+                    continue;
+                }
+                huffyuv_streams += 1;
+                if (!stream.valid) {
+                    invalid_streams += 1;
+                    std::fprintf(output, "invalid\n");
+                    continue;
+                }
+                std::fprintf(output, "huffyuv\t%s\t%s\t%s\t%s\n",
+                    format_name(stream.format),
+                    predictor_name(stream.predictor),
+                    stream.interlaced ? "interlaced" : "progressive",
+                    stream.decorrelated ? "decorrelated" : "correlated"
+                );
+            }
+        }
+        std::fprintf(output, "# %zu files, %llu unreadable, %llu huffyuv streams, %llu invalid.\n", this->entries.size(), unparsed, huffyuv_streams, invalid_streams);
+        if (std::ferror(output)) {
+            std::fprintf(stderr, "Error: Failed to write catalog report.\n");
+            return false;
+        }
+        return true;
+    }
+
+private:
+    void work() {
+        // The buffer the headers of each file are read into is kept between files.
+        std::vector<unsigned char> buffer;
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while (true) {
+            this->condition.wait(lock, [&]() {
+                return (!this->pending.empty()) || (this->busy == 0);
+            });
+            if (this->pending.empty()) {
+                return;
+            }
+            const pending_type item = this->pending.back();
+            this->pending.pop_back();
+            this->busy += 1;
+            lock.unlock();
+
+            std::vector<pending_type> children;
+            entry_type entry;
+            if (item.directory) {
+                list_directory(item.path, children);
+            }
+            else {
+                entry.path = item.path;
+                entry.parsed = read_entry(item.path, buffer, entry);
+            }
+
+            lock.lock();
+            this->busy -= 1;
+            this->pending.insert(this->pending.end(), children.begin(), children.end());
+            if (!item.directory) {
+                this->entries.push_back(std::move(entry));
+            }
+            this->condition.notify_all();
+        }
+    }
+
+    static bool is_directory(const std::string& path, bool& directory) {
+#if defined(_WIN32)
+        const DWORD attributes = GetFileAttributesA(path.c_str());
+        if (attributes == INVALID_FILE_ATTRIBUTES) {
+            return false;
+        }
+        directory = ((attributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+#else
+        struct stat file_status;
+        if (stat(path.c_str(), &file_status) != 0) {
+            return false;
+        }
+        directory = S_ISDIR(file_status.st_mode);
+#endif
+        return true;
+    }
+
+    static bool has_avi_extension(const char* name) {
+        const size_t length = std::strlen(name);
+        if (length < 4) {
+            return false;
+        }
+        const char* extension = &name[length - 4];
+        return (extension[0] == '.') && ((extension[1] | 0x20) == 'a') && ((extension[2] | 0x20) == 'v') && ((extension[3] | 0x20) == 'i');
+    }
+
+    // Subdirectories and files with an avi extension, symbolic links to directories are not followed.
+    static void list_directory(const std::string& path, std::vector<pending_type>& children) {
+#if defined(_WIN32)
+        WIN32_FIND_DATAA find_data;
+        HANDLE find = FindFirstFileA((path + "\\*").c_str(), &find_data);
+        if (find == INVALID_HANDLE_VALUE) {
+            std::fprintf(stderr, "Warning: Failed to list directory '%s'.\n", path.c_str());
+            return;
+        }
+        do {
+            const char* name = find_data.cFileName;
+            if ((std::strcmp(name, ".") == 0) || (std::strcmp(name, "..") == 0)) {
+                continue;
+            }
+            if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+                if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0) {
+                    children.push_back({ path + "\\" + name, true });
+                }
+            }
+            else if (has_avi_extension(name)) {
+                children.push_back({ path + "\\" + name, false });
+            }
+        } while (FindNextFileA(find, &find_data));
+        FindClose(find);
+#else
+        DIR* directory = opendir(path.c_str());
+        if (directory == nullptr) {
+            std::fprintf(stderr, "Warning: Failed to list directory '%s'.\n", path.c_str());
+            return;
+        }
+        const std::string prefix = ((!path.empty()) && (path.back() == '/')) ? path : (path + "/");
+        while (const dirent* child = readdir(directory)) {
+            const char* name = child->d_name;
+            if ((std::strcmp(name, ".") == 0) || (std::strcmp(name, "..") == 0)) {
+                continue;
+            }
+            // The type is known without a stat from almost every file system.
+            bool child_directory = (child->d_type == DT_DIR);
+            if (child->d_type == DT_UNKNOWN) {
+                struct stat file_status;
+                child_directory = (lstat((prefix + name).c_str(), &file_status) == 0) && (S_ISDIR(file_status.st_mode));
+            }
+            if (child_directory) {
+                children.push_back({ prefix + name, true });
+            }
+            else if (has_avi_extension(name)) {
+                children.push_back({ prefix + name, false });
+            }
+        }
+        closedir(directory);
+#endif
+    }
+
+    static bool read_entry(const std::string& path, std::vector<unsigned char>& buffer, entry_type& entry) {
+        // Only the headers are read, reading ahead would just read frame data.
+        avi::file_type file;
+        if (!avi::open_file(path.c_str(), avi::access_type::random, false, file)) {
+            return false;
+        }
+        const bool parsed = read_headers(file, buffer, entry);
+        avi::close_file(file);
+        return parsed;
+    }
+
+    static bool read_headers(avi::file_type file, std::vector<unsigned char>& buffer, entry_type& entry) {
+        buffer.resize(static_cast<size_t>(header_read_size));
+        const unsigned long long int read_length = avi::read_at(file, 0, buffer.data(), buffer.size());
+        if ((read_length < 12) || (std::memcmp(&buffer[0], "RIFF", 4) != 0) || (std::memcmp(&buffer[8], "AVI ", 4) != 0)) {
+            return false;
+        }
+
+        // Find the LIST[hdrl] chunk, reading the rest of it when it is longer than the first read.
+        unsigned long long int hdrl_offset = 12;
+        unsigned long long int hdrl_size = 0;
+        while (hdrl_offset + 12 <= read_length) {
+            unsigned int length = 0;
+            std::memcpy(&length, &buffer[static_cast<size_t>(hdrl_offset + 4)], 4);
+            const unsigned long long int size = 8ull + length + (length % 2);
+            if ((std::memcmp(&buffer[static_cast<size_t>(hdrl_offset)], "LIST", 4) == 0) && (std::memcmp(&buffer[static_cast<size_t>(hdrl_offset + 8)], "hdrl", 4) == 0)) {
+                hdrl_size = size;
+                break;
+            }
+            hdrl_offset += size;
+        }
+        if ((hdrl_size < 12) || (hdrl_size > avi::max_frame_length)) {
+            return false;
+        }
+        if (hdrl_offset + hdrl_size > read_length) {
+            buffer.resize(static_cast<size_t>(hdrl_offset + hdrl_size));
+            if (avi::read_at(file, read_length, &buffer[static_cast<size_t>(read_length)], buffer.size() - read_length) != buffer.size() - read_length) {
+                return false;
+            }
+        }
+
+        avi headers;
+        if (!headers.parse_header_list(&buffer[static_cast<size_t>(hdrl_offset)], hdrl_size)) {
+            return false;
+        }
+        for (size_t stream = 0; stream < headers.get_streams(); ++stream) {
+            const avi::stream_type& stream_data = headers.get_stream(stream);
+            if (stream_data.strf_vids == nullptr) {
+                continue;
+            }
+            stream_entry_type stream_entry = {};
+            stream_entry.stream = stream;
+            stream_entry.compression_identifier = stream_data.strf_vids->compression_identifier;
+            stream_entry.width = stream_data.strf_vids->width;
+            stream_entry.height = stream_data.strf_vids->height;
+            stream_entry.bit_count = stream_data.strf_vids->bit_count;
+            stream_entry.frame_count = stream_data.strh->length;
+            stream_entry.rate = stream_data.strh->rate;
+            stream_entry.scale = stream_data.strh->scale;
+            stream_entry.huffyuv = (stream_entry.compression_identifier == avi::fourcc("HFYU"));
+            if (stream_entry.huffyuv) {
+                // The header size is trusted only as far as the strf chunk, whose length was checked when parsed.
+                const unsigned char* strf_data = reinterpret_cast<const unsigned char*>(stream_data.strf_vids);
+                const unsigned long long int strf_available = avi::read_u32(strf_data - 4);
+                const unsigned long long int strf_length = (stream_data.strf_vids->header_size < strf_available) ? stream_data.strf_vids->header_size : strf_available;
+                const huffyuv codec(strf_data, strf_length);
+                stream_entry.valid = codec.is_valid();
+                stream_entry.format = codec.get_image_format();
+                stream_entry.predictor = codec.get_image_predictor();
+                stream_entry.interlaced = codec.is_interlaced();
+                stream_entry.decorrelated = codec.is_decorrelated();
+            }
+            entry.streams.push_back(stream_entry);
+        }
+        return true;
+    }
+
+    static const char* format_name(huffyuv::format_type format) {
+        switch (format) {
+            case huffyuv::format_type::yuyv: {
+                return "yuyv";
+            }
+            case huffyuv::format_type::bgr: {
+                return "bgr";
+            }
+            case huffyuv::format_type::bgra: {
+                return "bgra";
+            }
+        }
+        return "unknown";
+    }
+
+    static const char* predictor_name(huffyuv::predictor_type predictor) {
+        switch (predictor) {
+            case huffyuv::predictor_type::classic: {
+                return "classic";
+            }
+            case huffyuv::predictor_type::left: {
+                return "left";
+            }
+            case huffyuv::predictor_type::gradient: {
+                return "gradient";
+            }
+            case huffyuv::predictor_type::median: {
+                return "median";
+            }
+        }
+        return "unknown";
+    }
+};
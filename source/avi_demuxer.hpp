@@ -0,0 +1,225 @@
+#pragma once
+
+#include "avi.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Incrementally demuxes an avi as its bytes arrive, for sources that cannot seek such as pipes and sockets.
+// Bytes are held in a fixed size buffer that is reused, it must be large enough for the header list and the largest frame.
+// Frames are returned in file order as soon as they are complete, neither an index nor a complete file is required.
+class avi_demuxer final {
+public:
+    enum class result_type {
+        // More bytes are needed before anything else can be returned.
+        need_data,
+        // A complete frame was returned.
+        frame,
+        // The source has finished and every complete frame has been returned.
+        end,
+        // The data is invalid or a chunk does not fit in the buffer.
+        failed
+    };
+
+private:
+    std::vector<unsigned char> buffer;
+    unsigned long long int buffer_begin;
+    unsigned long long int buffer_end;
+    // Bytes of the current chunk still to be discarded, they do not need to be buffered.
+    unsigned long long int skip_remaining;
+    // Bytes needed from the start of the buffered data to make progress.
+    unsigned long long int required;
+    bool found_riff;
+    bool found_headers;
+    bool finished;
+    bool invalid;
+    avi headers;
+
+public:
+    explicit avi_demuxer(unsigned long long int buffer_capacity)
+        : buffer(buffer_capacity)
+        , buffer_begin(0)
+        , buffer_end(0)
+        , skip_remaining(0)
+        , required(0)
+        , found_riff(false)
+        , found_headers(false)
+        , finished(false)
+        , invalid(false)
+        , headers() {
+    }
+
+    avi_demuxer(const avi_demuxer&) = delete;
+    avi_demuxer& operator=(const avi_demuxer&) = delete;
+
+public:
+    // Copy as many bytes as there is space for, returns the number of bytes taken.
+    // Frames returned previously are invalidated.
+    unsigned long long int push(const unsigned char* data, unsigned long long int length) {
+        unsigned long long int space = 0;
+        unsigned char* destination = this->prepare(space);
+        const unsigned long long int accepted = (length < space) ? length : space;
+        std::memcpy(destination, data, static_cast<size_t>(accepted));
+        this->buffer_end += accepted;
+        return accepted;
+    }
+
+    // No more bytes will be pushed, a trailing incomplete chunk is dropped.
+    void finish() {
+        this->finished = true;
+    }
+
+    // Return the next frame and its stream number from the pushed bytes.
+    // The frame data is valid until the next call to push or next.
+    result_type next(avi::frame_type& frame, unsigned int& stream_number) {
+        while (!this->invalid) {
+            // Discard skipped chunk data as it arrives.
+            if (this->skip_remaining > 0) {
+                const unsigned long long int available = this->buffer_end - this->buffer_begin;
+                const unsigned long long int skipped = (this->skip_remaining < available) ? this->skip_remaining : available;
+                this->buffer_begin += skipped;
+                this->skip_remaining -= skipped;
+                if (this->skip_remaining > 0) {
+                    return this->need(0);
+                }
+            }
+
+            const unsigned char* data = this->buffer.data() + this->buffer_begin;
+            const unsigned long long int available = this->buffer_end - this->buffer_begin;
+
+            // RIFF[AVI ]
+            if (!this->found_riff) {
+                if (available < 12) {
+                    return this->need(12);
+                }
+                if ((avi::read_u32(&data[0]) != avi::fourcc("RIFF")) || (avi::read_u32(&data[8]) != avi::fourcc("AVI "))) {
+                    return this->fail("Error: Stream does not start with a 'RIFF[AVI ]' chunk.\n");
+                }
+                this->buffer_begin += 12;
+                this->found_riff = true;
+                continue;
+            }
+
+            if (available < 8) {
+                return this->need(8);
+            }
+            const unsigned int identifier = avi::read_u32(&data[0]);
+            const unsigned int length = avi::read_u32(&data[4]);
+            const unsigned long long int padded_length = 8ull + length + (length % 2);
+
+            // The lengths of lists containing frames are not used, they are not final until a capture completes.
+            // Extended RIFF[AVIX] and LIST[movi] or LIST[rec ] chunks are entered and their children handled in order.
+            if ((identifier == avi::fourcc("RIFF")) || (identifier == avi::fourcc("LIST"))) {
+                if (available < 12) {
+                    return this->need(12);
+                }
+                const unsigned int form = avi::read_u32(&data[8]);
+                if (
+                    ((identifier == avi::fourcc("RIFF")) && (form == avi::fourcc("AVIX"))) ||
+                    ((identifier == avi::fourcc("LIST")) && ((form == avi::fourcc("movi")) || (form == avi::fourcc("rec "))))
+                ) {
+                    if (!this->found_headers) {
+                        return this->fail("Error: Stream data found before 'LIST[hdrl]' chunk.\n");
+                    }
+                    this->buffer_begin += 12;
+                    continue;
+                }
+                if ((identifier == avi::fourcc("LIST")) && (form == avi::fourcc("hdrl")) && (!this->found_headers)) {
+                    if (padded_length > this->buffer.size()) {
+                        return this->fail("Error: 'LIST[hdrl]' chunk is larger than the buffer.\n");
+                    }
+                    if (available < padded_length) {
+                        return this->need(padded_length);
+                    }
+                    if (!this->headers.parse_header_list(data, padded_length)) {
+                        return this->fail("Error: Failed to parse 'LIST[hdrl]' chunk.\n");
+                    }
+                    this->buffer_begin += padded_length;
+                    this->found_headers = true;
+                    continue;
+                }
+            }
+
+            // Frames are returned once complete, the padding byte is skipped afterwards so is not waited for.
+            const int stream_id = (avi::hex_to_dec(static_cast<unsigned char>(identifier >> 0)) * 16) + avi::hex_to_dec(static_cast<unsigned char>(identifier >> 8));
+            if (
+                (this->found_headers) &&
+                (avi::hex_to_dec(static_cast<unsigned char>(identifier >> 0)) >= 0) &&
+                (avi::hex_to_dec(static_cast<unsigned char>(identifier >> 8)) >= 0) &&
+                (stream_id < static_cast<int>(this->headers.get_streams()))
+            ) {
+                if (8ull + length > this->buffer.size()) {
+                    return this->fail("Error: Frame is larger than the buffer.\n");
+                }
+                if (available < 8ull + length) {
+                    return this->need(8ull + length);
+                }
+                frame.data = &data[8];
+                frame.length = length;
+                stream_number = static_cast<unsigned int>(stream_id);
+                this->buffer_begin += 8ull + length;
+                this->skip_remaining = length % 2;
+                this->required = 0;
+                return result_type::frame;
+            }
+
+            // Anything else, such as JUNK, idx1 or indexes, is skipped without buffering it.
+            this->buffer_begin += 8;
+            this->skip_remaining = padded_length - 8;
+        }
+        return result_type::failed;
+    }
+
+    // Return the next frame reading bytes directly into the buffer from a source as needed.
+    // The source is called as source(data, length) and returns the number of bytes read, zero once it has finished.
+    template <typename source_type>
+    result_type next(avi::frame_type& frame, unsigned int& stream_number, source_type&& source) {
+        for (;;) {
+            const result_type result = this->next(frame, stream_number);
+            if ((result != result_type::need_data) || (this->finished)) {
+                return result;
+            }
+            unsigned long long int space = 0;
+            unsigned char* destination = this->prepare(space);
+            const unsigned long long int read = source(destination, space);
+            if (read == 0) {
+                this->finish();
+            }
+            this->buffer_end += read;
+        }
+    }
+
+public:
+    bool has_headers() const {
+        return this->found_headers;
+    }
+
+    // The headers are available once has_headers returns true, the stream frames are always empty.
+    const avi& get_headers() const {
+        return this->headers;
+    }
+
+private:
+    // Make space at the end of the buffer, moving the buffered bytes to the start when the pending chunk would not fit.
+    unsigned char* prepare(unsigned long long int& space) {
+        if ((this->buffer_end == this->buffer.size()) || (this->buffer_begin + this->required > this->buffer.size())) {
+            std::memmove(this->buffer.data(), this->buffer.data() + this->buffer_begin, static_cast<size_t>(this->buffer_end - this->buffer_begin));
+            this->buffer_end -= this->buffer_begin;
+            this->buffer_begin = 0;
+        }
+        space = this->buffer.size() - this->buffer_end;
+        return this->buffer.data() + this->buffer_end;
+    }
+
+    result_type need(unsigned long long int length) {
+        this->required = length;
+        return this->finished ? result_type::end : result_type::need_data;
+    }
+
+    result_type fail(const char* message) {
+        std::fprintf(stderr, "%s", message);
+        this->invalid = true;
+        return result_type::failed;
+    }
+};
@@ -0,0 +1,490 @@
+#pragma once
+
+#include "avi.hpp"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+    #if !defined(NOMINMAX)
+        #define NOMINMAX
+    #endif
+    #if !defined(WIN32_LEAN_AND_MEAN)
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Reads the frames of one stream of an avi in order, with an I/O thread reading ahead so frames are resident before they are needed.
+// The file is parsed without loading frames and the frame data is then read with pread into a ring buffer, never through the mapping.
+// Frames are acquired in order and released in any order, the space of a frame is reused once it and every frame before it are released.
+// Acquiring and releasing frames is thread safe, so several decoder threads can share one reader.
+// A file that is still being written can be followed, only its headers are parsed on opening and each refresh appends the frames written since.
+class avi_reader final {
+public:
+    // Default number of bytes of frame data read ahead of the frames acquired.
+    constexpr static const unsigned long long int default_read_ahead = 0x04000000;
+
+private:
+    struct location_type {
+        unsigned long long int offset;
+        unsigned long long int length;
+    };
+
+    enum class state_type {
+        // The I/O thread is reading the frame.
+        reading,
+        // The frame is resident, or failed to read, and waiting to be acquired.
+        ready,
+        acquired,
+        released
+    };
+
+    // A frame in the ring buffer, positions increase forever and are wrapped to the size of the buffer.
+    struct entry_type {
+        unsigned long long int frame_number;
+        unsigned long long int position;
+        unsigned long long int length;
+        state_type state;
+        bool read;
+    };
+
+private:
+    avi video;
+    avi::file_type file;
+    // Following a growing file, the headers are parsed from a copy and the file is scanned for frames from the scan offset on each refresh.
+    bool growing;
+    size_t stream;
+    unsigned long long int scan_offset;
+    std::vector<location_type> locations;
+    std::vector<unsigned char> buffer;
+    std::thread thread;
+    // Everything below is shared with the I/O thread.
+    mutable std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+    // The I/O thread is reading outside the lock, the ring cannot be reset until it has finished.
+    bool reading;
+    // Incremented on each seek, so a read started before a seek is discarded.
+    unsigned long long int generation;
+    // Frames in the ring buffer in order, from the oldest not yet released to the newest being read.
+    std::deque<entry_type> entries;
+    unsigned long long int next_read;
+    unsigned long long int next_acquire;
+    unsigned long long int read_position;
+
+public:
+    avi_reader()
+        : video()
+#if defined(_WIN32)
+        , file(INVALID_HANDLE_VALUE)
+#else
+        , file(-1)
+#endif
+        , growing(false)
+        , stream(0)
+        , scan_offset(0)
+        , locations()
+        , buffer()
+        , thread()
+        , mutex()
+        , condition()
+        , stopping(false)
+        , reading(false)
+        , generation(0)
+        , entries()
+        , next_read(0)
+        , next_acquire(0)
+        , read_position(0) {
+    }
+
+    ~avi_reader() {
+        this->close();
+    }
+
+    avi_reader(const avi_reader&) = delete;
+    avi_reader& operator=(const avi_reader&) = delete;
+
+public:
+    // Open a file and start reading ahead from the first frame of a stream.
+    // The ring buffer holds read_ahead bytes of frame data, enlarged when needed to hold the largest frame.
+    bool open(const char* path, size_t stream_index, unsigned long long int read_ahead = default_read_ahead) {
+        this->close();
+
+        if (!this->video.open(path, avi::access_type::random, false)) {
+            return false;
+        }
+        if (stream_index >= this->video.get_streams()) {
+            std::fprintf(stderr, "Error: Failed to open avi reader, stream %zu does not exist.\n", stream_index);
+            this->close();
+            return false;
+        }
+
+        if (!avi::open_file(path, avi::access_type::sequential, true, this->file)) {
+            this->close();
+            return false;
+        }
+
+        // Only the locations of the frames are kept, so the pages of the frame data are never touched through the mapping.
+        const unsigned long long int frame_count = this->video.get_frame_count(stream_index);
+        this->locations.resize(static_cast<size_t>(frame_count));
+        unsigned long long int largest_frame = 0;
+        for (size_t frame_number = 0; frame_number < this->locations.size(); ++frame_number) {
+            avi::frame_type frame;
+            if (!this->video.get_frame(stream_index, frame_number, frame)) {
+                this->close();
+                return false;
+            }
+            this->locations[frame_number].offset = this->video.get_frame_offset(frame);
+            this->locations[frame_number].length = frame.length;
+            largest_frame = (frame.length > largest_frame) ? frame.length : largest_frame;
+        }
+        this->start((read_ahead > largest_frame) ? read_ahead : largest_frame);
+        return true;
+    }
+
+    // Open a file that may still be being written and start reading ahead from the first frame of a stream.
+    // Only the LIST[hdrl] chunk must have been written, the sizes of the RIFF and LIST chunks holding frames are not used as they are not final until the capture completes.
+    // The frames written so far are found on opening and those written since on each refresh, the ring buffer must be large enough to hold any of them.
+    bool open_growing(const char* path, size_t stream_index, unsigned long long int read_ahead = default_read_ahead) {
+        this->close();
+
+        if (!avi::open_file(path, avi::access_type::sequential, true, this->file)) {
+            this->close();
+            return false;
+        }
+        if (!this->parse_growing_headers()) {
+            std::fprintf(stderr, "Error: Failed to parse the headers of growing file '%s'.\n", path);
+            this->close();
+            return false;
+        }
+        if (stream_index >= this->video.get_streams()) {
+            std::fprintf(stderr, "Error: Failed to open avi reader, stream %zu does not exist.\n", stream_index);
+            this->close();
+            return false;
+        }
+
+        this->growing = true;
+        this->stream = stream_index;
+        this->start(read_ahead);
+        if (!this->refresh()) {
+            this->close();
+            return false;
+        }
+        return true;
+    }
+
+    // Check the size of a growing file and append the frames written since the last refresh, the read ahead continues into them.
+    // Frames are found by following chunks from the last one found, so only the data appended is read and nothing is parsed again.
+    // Must not be called from more than one thread at once, acquiring and releasing frames can continue meanwhile.
+    bool refresh() {
+        if (!this->is_open()) {
+            return false;
+        }
+        if (!this->growing) {
+            return true;
+        }
+
+        unsigned long long int file_length = 0;
+        if (!this->get_file_length(file_length)) {
+            std::fprintf(stderr, "Error: Failed to get the size of growing avi file.\n");
+            return false;
+        }
+        std::vector<location_type> found;
+        while (this->scan_offset + 8 <= file_length) {
+            unsigned char header[12];
+            const unsigned long long int header_length = (this->scan_offset + 12 <= file_length) ? 12 : 8;
+            if (!this->read_at(this->scan_offset, header, header_length)) {
+                std::fprintf(stderr, "Error: Failed to read chunk of growing avi file.\n");
+                return false;
+            }
+            unsigned int length = 0;
+            std::memcpy(&length, &header[4], 4);
+
+            // Space allocated but not yet written, such as the padding of a direct I/O write, reads as zeros.
+            if ((header[0] == 0) && (header[1] == 0) && (header[2] == 0) && (header[3] == 0)) {
+                break;
+            }
+            // Extended RIFF[AVIX] and LIST[movi] or LIST[rec ] chunks are entered whatever their sizes.
+            if ((std::memcmp(header, "RIFF", 4) == 0) || (std::memcmp(header, "LIST", 4) == 0)) {
+                if (header_length < 12) {
+                    break;
+                }
+                if (
+                    ((std::memcmp(header, "RIFF", 4) == 0) && (std::memcmp(&header[8], "AVIX", 4) == 0)) ||
+                    ((std::memcmp(header, "LIST", 4) == 0) && ((std::memcmp(&header[8], "movi", 4) == 0) || (std::memcmp(&header[8], "rec ", 4) == 0)))
+                ) {
+                    this->scan_offset += 12;
+                    continue;
+                }
+            }
+
+            // Frames are found once complete, other chunks are skipped once the header after them can be read.
+            const unsigned long long int next = this->scan_offset + 8 + length + (length % 2);
+            const int high = avi::hex_to_dec(header[0]);
+            const int low = avi::hex_to_dec(header[1]);
+            if ((high >= 0) && (low >= 0) && (static_cast<size_t>(high * 16 + low) == this->stream) && (header[2] == 'd') && ((header[3] == 'c') || (header[3] == 'b'))) {
+                if (this->scan_offset + 8 + length > file_length) {
+                    break;
+                }
+                if (length > this->buffer.size()) {
+                    std::fprintf(stderr, "Error: Frame of growing avi file is larger than the read ahead buffer.\n");
+                    return false;
+                }
+                found.push_back({ this->scan_offset + 8, length });
+            }
+            else if (next > file_length) {
+                break;
+            }
+            this->scan_offset = next;
+        }
+
+        if (!found.empty()) {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->locations.insert(this->locations.end(), found.begin(), found.end());
+            }
+            this->condition.notify_all();
+        }
+        return true;
+    }
+
+    // Stop reading ahead and close the file, invalidating all acquired frames.
+    void close() {
+        if (this->thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->stopping = true;
+            }
+            this->condition.notify_all();
+            this->thread.join();
+        }
+        avi::close_file(this->file);
+        this->video.close();
+        this->growing = false;
+        this->stream = 0;
+        this->scan_offset = 0;
+        this->locations.clear();
+        this->buffer.clear();
+        this->entries.clear();
+    }
+
+    bool is_open() const {
+        return this->thread.joinable();
+    }
+
+    // The parsed file, for its headers and the strf_vids of the stream.
+    const avi& get_avi() const {
+        return this->video;
+    }
+
+    // Frames found so far, which only grows on refresh when following a growing file.
+    unsigned long long int get_frame_count() const {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->locations.size();
+    }
+
+public:
+    // Wait for the next frame to be resident and acquire it, the data stays valid until the frame is released.
+    // Fails at the end of the stream, or when the frame could not be read, a growing file may have more frames after a refresh.
+    // Holding more than the read ahead bytes of frames without releasing them blocks, the next frame has nowhere to be read to.
+    bool acquire_frame(avi::frame_type& frame, unsigned long long int& frame_number) {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        if ((!this->is_open()) || (this->next_acquire >= this->locations.size())) {
+            return false;
+        }
+        // Another thread may acquire the last frame while waiting.
+        entry_type* entry = nullptr;
+        this->condition.wait(lock, [&]() {
+            entry = this->find_entry(this->next_acquire);
+            return (this->next_acquire >= this->locations.size()) || ((entry != nullptr) && (entry->state == state_type::ready));
+        });
+        if (this->next_acquire >= this->locations.size()) {
+            return false;
+        }
+        entry->state = state_type::acquired;
+        frame_number = this->next_acquire;
+        this->next_acquire += 1;
+        if (!entry->read) {
+            std::fprintf(stderr, "Error: Failed to read frame %llu of avi file.\n", frame_number);
+            this->release_entry(*entry);
+            return false;
+        }
+        frame.data = &this->buffer[static_cast<size_t>(entry->position % this->buffer.size())];
+        frame.length = entry->length;
+        return true;
+    }
+
+    // Release an acquired frame, its data must not be used afterwards.
+    void release_frame(unsigned long long int frame_number) {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        entry_type* entry = this->find_entry(frame_number);
+        if ((entry != nullptr) && (entry->state == state_type::acquired)) {
+            this->release_entry(*entry);
+        }
+    }
+
+    // Restart reading ahead from a frame, frames acquired before seeking must not be used afterwards.
+    bool seek(unsigned long long int frame_number) {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        if ((!this->is_open()) || (frame_number > this->locations.size())) {
+            return false;
+        }
+        this->generation += 1;
+        this->condition.wait(lock, [&]() {
+            return !this->reading;
+        });
+        this->entries.clear();
+        this->next_read = frame_number;
+        this->next_acquire = frame_number;
+        this->read_position = 0;
+        lock.unlock();
+        this->condition.notify_all();
+        return true;
+    }
+
+private:
+    bool get_file_length(unsigned long long int& file_length) const {
+#if defined(_WIN32)
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(this->file, &file_size)) {
+            return false;
+        }
+        file_length = static_cast<unsigned long long int>(file_size.QuadPart);
+#else
+        struct stat file_status;
+        if (fstat(this->file, &file_status) != 0) {
+            return false;
+        }
+        file_length = static_cast<unsigned long long int>(file_status.st_size);
+#endif
+        return true;
+    }
+
+    // Size the ring buffer and start the I/O thread.
+    void start(unsigned long long int buffer_size) {
+        this->buffer.resize(static_cast<size_t>((buffer_size > 0) ? buffer_size : 1));
+        this->stopping = false;
+        this->reading = false;
+        this->generation = 0;
+        this->entries.clear();
+        this->next_read = 0;
+        this->next_acquire = 0;
+        this->read_position = 0;
+        this->thread = std::thread(&avi_reader::read_ahead, this);
+    }
+
+    // Read the RIFF[AVI ]->LIST[hdrl] chunk of a growing file and parse it on its own, setting the offset to scan for frames from.
+    bool parse_growing_headers() {
+        unsigned long long int file_length = 0;
+        unsigned char riff_header[12];
+        if ((!this->get_file_length(file_length)) || (file_length < 12) || (!this->read_at(0, riff_header, 12))) {
+            return false;
+        }
+        if ((std::memcmp(riff_header, "RIFF", 4) != 0) || (std::memcmp(&riff_header[8], "AVI ", 4) != 0)) {
+            return false;
+        }
+        unsigned long long int offset = 12;
+        while (offset + 12 <= file_length) {
+            unsigned char header[12];
+            if (!this->read_at(offset, header, 12)) {
+                return false;
+            }
+            unsigned int length = 0;
+            std::memcpy(&length, &header[4], 4);
+            const unsigned long long int next = offset + 8 + length + (length % 2);
+            if ((std::memcmp(header, "LIST", 4) != 0) || (std::memcmp(&header[8], "hdrl", 4) != 0)) {
+                offset = next;
+                continue;
+            }
+            if ((length < 4) || (next > file_length)) {
+                return false;
+            }
+
+            // The OpenDML indexes are not final until the capture completes, frames are found in file order instead.
+            std::vector<unsigned char> hdrl(static_cast<size_t>(next - offset));
+            if ((!this->read_at(offset, hdrl.data(), hdrl.size())) || (!this->video.parse_header_list(hdrl.data(), hdrl.size()))) {
+                return false;
+            }
+            this->scan_offset = next;
+            return true;
+        }
+        return false;
+    }
+
+    entry_type* find_entry(unsigned long long int frame_number) {
+        if ((this->entries.empty()) || (frame_number < this->entries.front().frame_number) || (frame_number - this->entries.front().frame_number >= this->entries.size())) {
+            return nullptr;
+        }
+        return &this->entries[static_cast<size_t>(frame_number - this->entries.front().frame_number)];
+    }
+
+    // Mark a frame released and free the space of the released frames at the start of the ring, must be called with the lock held.
+    void release_entry(entry_type& entry) {
+        entry.state = state_type::released;
+        while ((!this->entries.empty()) && (this->entries.front().state == state_type::released)) {
+            this->entries.pop_front();
+        }
+        this->condition.notify_all();
+    }
+
+    // Position in the ring at which a frame can be read, frames are kept contiguous by skipping to the start of the buffer when one would wrap.
+    // Returns false when the frame does not fit in the space released so far.
+    bool reserve(unsigned long long int length, unsigned long long int& position) const {
+        const unsigned long long int size = this->buffer.size();
+        position = this->read_position;
+        if ((position % size) + length > size) {
+            position += size - (position % size);
+        }
+        if (this->entries.empty()) {
+            return true;
+        }
+        return (position + length - this->entries.front().position <= size);
+    }
+
+    void read_ahead() {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while (true) {
+            unsigned long long int position = 0;
+            this->condition.wait(lock, [&]() {
+                return (this->stopping) || ((this->next_read < this->locations.size()) && (this->reserve(this->locations[static_cast<size_t>(this->next_read)].length, position)));
+            });
+            if (this->stopping) {
+                return;
+            }
+
+            const unsigned long long int frame_number = this->next_read;
+            const location_type location = this->locations[static_cast<size_t>(frame_number)];
+            this->entries.push_back({ frame_number, position, location.length, state_type::reading, false });
+            this->next_read += 1;
+            this->read_position = position + location.length;
+            this->reading = true;
+            const unsigned long long int read_generation = this->generation;
+            lock.unlock();
+
+            const bool read = this->read_at(location.offset, &this->buffer[static_cast<size_t>(position % this->buffer.size())], location.length);
+
+            lock.lock();
+            this->reading = false;
+            if (read_generation == this->generation) {
+                entry_type* entry = this->find_entry(frame_number);
+                entry->state = state_type::ready;
+                entry->read = read;
+            }
+            this->condition.notify_all();
+        }
+    }
+
+    bool read_at(unsigned long long int position, unsigned char* data, unsigned long long int length) const {
+        return avi::read_at(this->file, position, data, length) == length;
+    }
+};
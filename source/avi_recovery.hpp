@@ -0,0 +1,322 @@
+#pragma once
+
+#include "avi.hpp"
+#include "avi_writer.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Recovers the frames of a damaged avi, one that was truncated, lost its indexes or has chunk sizes that cannot be trusted.
+// Only the LIST[hdrl] headers must be intact, the rest of the file is scanned for frame chunks without using any RIFF or LIST sizes.
+// Chunks are followed from one to the next by their sizes, each accepted only when another chunk header, or the end of the file, follows it.
+// Where that fails the scan resynchronises on the next frame chunk identifier, searching eight bytes at a time.
+// Healthy stretches of the file are crossed touching only the chunk headers, so the scan runs at least as fast as the disk.
+// The frames found are then copied, without decoding, to a new file with complete indexes.
+class avi_recovery final {
+private:
+    struct frame_location_type {
+        unsigned long long int offset;
+        unsigned int length;
+        unsigned int stream;
+        // Found as a '##db' chunk.
+        bool uncompressed;
+    };
+
+    enum class chunk_class_type {
+        frame,
+        list,
+        other,
+        unknown
+    };
+
+private:
+    std::string path;
+    const unsigned char* mapping_data;
+    unsigned long long int mapping_length;
+    avi headers;
+    // Every frame chunk found, in the order they are in the file.
+    std::vector<frame_location_type> frames;
+    std::vector<unsigned long long int> stream_frames;
+    unsigned long long int skipped_bytes;
+
+public:
+    avi_recovery()
+        : path()
+        , mapping_data(nullptr)
+        , mapping_length(0)
+        , headers()
+        , frames()
+        , stream_frames()
+        , skipped_bytes(0) {
+    }
+
+    ~avi_recovery() {
+        this->close();
+    }
+
+    avi_recovery(const avi_recovery&) = delete;
+    avi_recovery& operator=(const avi_recovery&) = delete;
+
+public:
+    // Map a file, parse its headers and find every complete frame chunk in it.
+    bool scan(const char* file_path) {
+        this->close();
+
+        unsigned long long int file_time = 0;
+        if ((file_path == nullptr) || (!avi::map_file(file_path, avi::access_type::random, true, this->mapping_data, this->mapping_length, file_time))) {
+            return false;
+        }
+        this->path = file_path;
+
+        unsigned long long int offset = 0;
+        if (!this->parse_headers(offset)) {
+            std::fprintf(stderr, "Error: Failed to recover file '%s', its headers are damaged.\n", file_path);
+            this->close();
+            return false;
+        }
+        this->stream_frames.assign(this->headers.get_streams(), 0);
+
+        while (offset + 8 <= this->mapping_length) {
+            const chunk_class_type chunk_class = this->classify(offset);
+            if (chunk_class == chunk_class_type::list) {
+                // RIFF and LIST sizes are not trusted, their contents are scanned in order like everything else.
+                offset += 12;
+                continue;
+            }
+            const unsigned long long int next = this->follow(offset, true);
+            if ((chunk_class != chunk_class_type::unknown) && (next != 0)) {
+                if (chunk_class == chunk_class_type::frame) {
+                    const unsigned int length = avi::read_u32(&this->mapping_data[offset + 4]);
+                    const unsigned int stream = static_cast<unsigned int>(avi::hex_to_dec(this->mapping_data[offset]) * 16 + avi::hex_to_dec(this->mapping_data[offset + 1]));
+                    this->frames.push_back({ offset + 8, length, stream, this->mapping_data[offset + 3] == 'b' });
+                    this->stream_frames[stream] += 1;
+                }
+                offset = next;
+                continue;
+            }
+
+            // Damaged, or the last chunk was cut short, resynchronise on the next frame chunk.
+            const unsigned long long int resynchronised = this->resynchronise(offset + 1);
+            this->skipped_bytes += resynchronised - offset;
+            offset = resynchronised;
+        }
+        this->skipped_bytes += this->mapping_length - offset;
+        return true;
+    }
+
+    // Write the frames found to a new file, with the headers of the damaged file and complete indexes, the file is removed if anything fails.
+    // The frame data is copied with avi_writer::copy_frame, through the kernel where the platform allows.
+    // Frames of streams that are not video are dropped, as avi_writer only writes video streams.
+    bool write(const char* output_path, unsigned long long int segment_size = avi::default_segment_size) {
+        if (this->mapping_data == nullptr) {
+            std::fprintf(stderr, "Error: Nothing recovered to write.\n");
+            return false;
+        }
+
+        avi::avih_type avih = *this->headers.get_avih();
+        std::vector<avi::stream_type> streams;
+        std::vector<unsigned int> stream_numbers(this->headers.get_streams(), ~0u);
+        for (size_t stream = 0; stream < this->headers.get_streams(); ++stream) {
+            const avi::stream_type& stream_data = this->headers.get_stream(stream);
+            if (stream_data.strf_vids == nullptr) {
+                continue;
+            }
+            stream_numbers[stream] = static_cast<unsigned int>(streams.size());
+            streams.emplace_back();
+            streams.back().strh = stream_data.strh;
+            streams.back().strf_vids = stream_data.strf_vids;
+        }
+        if (streams.empty()) {
+            std::fprintf(stderr, "Error: No video streams to recover.\n");
+            return false;
+        }
+        avih.stream_count = static_cast<unsigned int>(streams.size());
+
+        avi::file_type source;
+        if (!avi::open_file(this->path.c_str(), avi::access_type::sequential, true, source)) {
+            return false;
+        }
+
+        avi_writer writer;
+        bool success = writer.open(output_path, &avih, streams, segment_size);
+        for (size_t index_frame = 0; (success) && (index_frame < this->frames.size()); ++index_frame) {
+            const frame_location_type& frame = this->frames[index_frame];
+            if (stream_numbers[frame.stream] == ~0u) {
+                continue;
+            }
+            success = writer.copy_frame(stream_numbers[frame.stream], source, frame.offset, frame.length, frame.uncompressed);
+        }
+        success = writer.close() && success;
+        avi::close_file(source);
+        if (!success) {
+            std::fprintf(stderr, "Error: Failed to write recovered file '%s'.\n", output_path);
+            std::remove(output_path);
+        }
+        return success;
+    }
+
+    // Release the mapped file and everything found in it.
+    void close() {
+        if (this->mapping_data != nullptr) {
+            avi::unmap_file(this->mapping_data, this->mapping_length);
+        }
+        this->path.clear();
+        this->headers.close();
+        this->frames.clear();
+        this->stream_frames.clear();
+        this->skipped_bytes = 0;
+    }
+
+    // The headers of the damaged file, with no frames.
+    const avi& get_avi() const {
+        return this->headers;
+    }
+
+    unsigned long long int get_frame_count(size_t stream) const {
+        return (stream < this->stream_frames.size()) ? this->stream_frames[stream] : 0;
+    }
+
+    // A frame found, in the order frames are in the file, the data stays valid until the recovery is closed.
+    bool get_frame(size_t index, size_t& stream, avi::frame_type& frame) const {
+        if (index >= this->frames.size()) {
+            return false;
+        }
+        stream = this->frames[index].stream;
+        frame.data = &this->mapping_data[this->frames[index].offset];
+        frame.length = this->frames[index].length;
+        return true;
+    }
+
+    size_t get_frames() const {
+        return this->frames.size();
+    }
+
+    // Bytes of the file that were not part of the headers or any chunk found, damaged data and partial chunks.
+    unsigned long long int get_skipped_bytes() const {
+        return this->skipped_bytes;
+    }
+
+private:
+    // Find and parse the LIST[hdrl] chunk near the start of the file, giving the offset to scan for frames from.
+    // The indx super indexes are hidden, they point into the damaged file and cannot be trusted.
+    bool parse_headers(unsigned long long int& offset) {
+        const unsigned long long int search_length = (this->mapping_length < 0x01000000) ? this->mapping_length : 0x01000000;
+        unsigned long long int hdrl_offset = 0;
+        while ((hdrl_offset + 12 <= search_length) && ((std::memcmp(&this->mapping_data[hdrl_offset], "LIST", 4) != 0) || (std::memcmp(&this->mapping_data[hdrl_offset + 8], "hdrl", 4) != 0))) {
+            ++hdrl_offset;
+        }
+        if (hdrl_offset + 12 > search_length) {
+            return false;
+        }
+        const unsigned long long int hdrl_length = avi::read_u32(&this->mapping_data[hdrl_offset + 4]);
+        const unsigned long long int hdrl_size = 8 + hdrl_length + (hdrl_length % 2);
+        if (hdrl_offset + hdrl_size > this->mapping_length) {
+            return false;
+        }
+
+        if (!this->headers.parse_header_list(&this->mapping_data[hdrl_offset], hdrl_size)) {
+            return false;
+        }
+        offset = hdrl_offset + hdrl_size;
+        return true;
+    }
+
+    chunk_class_type classify(unsigned long long int offset) const {
+        const unsigned char* identifier = &this->mapping_data[offset];
+        if ((identifier[2] == 'd') && ((identifier[3] == 'c') || (identifier[3] == 'b'))) {
+            const int high = avi::hex_to_dec(identifier[0]);
+            const int low = avi::hex_to_dec(identifier[1]);
+            if ((high >= 0) && (low >= 0) && (static_cast<size_t>(high * 16 + low) < this->headers.get_streams()) && (avi::read_u32(&identifier[4]) <= avi::max_frame_length)) {
+                return chunk_class_type::frame;
+            }
+            return chunk_class_type::unknown;
+        }
+        if ((std::memcmp(identifier, "RIFF", 4) == 0) || (std::memcmp(identifier, "LIST", 4) == 0)) {
+            return chunk_class_type::list;
+        }
+        if (
+            (std::memcmp(identifier, "JUNK", 4) == 0) ||
+            (std::memcmp(identifier, "idx1", 4) == 0) ||
+            ((identifier[0] == 'i') && (identifier[1] == 'x') && (avi::hex_to_dec(identifier[2]) >= 0) && (avi::hex_to_dec(identifier[3]) >= 0)) ||
+            ((avi::hex_to_dec(identifier[0]) >= 0) && (avi::hex_to_dec(identifier[1]) >= 0) && (identifier[2] == 'w') && (identifier[3] == 'b'))
+        ) {
+            return chunk_class_type::other;
+        }
+        return chunk_class_type::unknown;
+    }
+
+    // The offset of the chunk after the one at the offset, or zero when its size does not lead to another chunk header or the end of the file.
+    // Following on from a chunk already accepted, the next header may instead have a damaged identifier as long as its size leads to a known header.
+    unsigned long long int follow(unsigned long long int offset, bool allow_damaged_next) const {
+        const unsigned long long int next = this->skip(offset);
+        if (next > this->mapping_length) {
+            // Cut short, though without its padding byte the chunk is still whole.
+            return (next - (avi::read_u32(&this->mapping_data[offset + 4]) % 2) == this->mapping_length) ? this->mapping_length : 0;
+        }
+        if ((next + 8 > this->mapping_length) || (this->classify(next) != chunk_class_type::unknown)) {
+            return next;
+        }
+        if (allow_damaged_next) {
+            const unsigned long long int after_next = this->skip(next);
+            if ((after_next == this->mapping_length) || ((after_next + 8 <= this->mapping_length) && (this->classify(after_next) != chunk_class_type::unknown))) {
+                return next;
+            }
+        }
+        return 0;
+    }
+
+    // The offset just past the chunk at the offset and its padding byte, going by its size alone.
+    unsigned long long int skip(unsigned long long int offset) const {
+        const unsigned long long int length = avi::read_u32(&this->mapping_data[offset + 4]);
+        return offset + 8 + length + (length % 2);
+    }
+
+    // The offset of the next frame chunk whose size leads to another chunk header, or the end of the file when there is none.
+    unsigned long long int resynchronise(unsigned long long int offset) const {
+        while (true) {
+            // Frame chunk identifiers end in "dc", or "db" for uncompressed frames.
+            const unsigned long long int match = find_pair(this->mapping_data, offset + 2, this->mapping_length, 'd');
+            if (match + 2 > this->mapping_length) {
+                return this->mapping_length;
+            }
+            const unsigned long long int candidate = match - 2;
+            if ((candidate + 8 <= this->mapping_length) && (this->classify(candidate) == chunk_class_type::frame) && (this->follow(candidate, false) != 0)) {
+                return candidate;
+            }
+            offset = candidate + 1;
+        }
+    }
+
+    // The offset of the next byte with the value first followed by 'c' or 'b', or the end when there is none.
+    // Eight offsets are tested at once by looking for zero bytes in words of both bytes compared to their values.
+    static unsigned long long int find_pair(const unsigned char* data, unsigned long long int offset, unsigned long long int end, unsigned char first) {
+        constexpr static const std::uint64_t ones = 0x0101010101010101ull;
+        constexpr static const std::uint64_t highs = 0x8080808080808080ull;
+        const std::uint64_t pattern_first = ones * first;
+        const std::uint64_t pattern_c = ones * 'c';
+        const std::uint64_t pattern_b = ones * 'b';
+        while (offset + 9 <= end) {
+            std::uint64_t word_first;
+            std::uint64_t word_second;
+            std::memcpy(&word_first, &data[offset], 8);
+            std::memcpy(&word_second, &data[offset + 1], 8);
+            const std::uint64_t differs_first = word_first ^ pattern_first;
+            const std::uint64_t differs_c = differs_first | (word_second ^ pattern_c);
+            const std::uint64_t differs_b = differs_first | (word_second ^ pattern_b);
+            if ((((differs_c - ones) & ~differs_c) | ((differs_b - ones) & ~differs_b)) & highs) {
+                break;
+            }
+            offset += 8;
+        }
+        while (offset + 2 <= end) {
+            if ((data[offset] == first) && ((data[offset + 1] == 'c') || (data[offset + 1] == 'b'))) {
+                return offset;
+            }
+            ++offset;
+        }
+        return end;
+    }
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "avi.hpp"
+#include "avi_writer.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Cuts, trims and joins avi files without decoding, every huffyuv frame is a keyframe so frames can be copied between files as they are.
+// Sources are added as ranges of frames or times, each must match the first in its streams, strf_vids headers and frame rates.
+// The frame data is copied from file to file with avi_writer::copy_frame, through the kernel where the platform allows.
+class avi_remuxer final {
+public:
+    // Frame count of a range that runs to the end of the file.
+    constexpr static const unsigned long long int all_frames = ~0ull;
+
+private:
+    struct source_type {
+        std::string path;
+        std::unique_ptr<avi> video;
+        // The frames of each stream to copy, from the first up to but not including the end.
+        std::vector<unsigned long long int> first_frames;
+        std::vector<unsigned long long int> end_frames;
+    };
+
+private:
+    std::vector<source_type> sources;
+
+public:
+    avi_remuxer()
+        : sources() {
+    }
+
+    avi_remuxer(const avi_remuxer&) = delete;
+    avi_remuxer& operator=(const avi_remuxer&) = delete;
+
+public:
+    // Add a range of frames of a file, the frame numbers apply to each stream and are clamped to its frames.
+    bool add_frames(const char* path, unsigned long long int first_frame, unsigned long long int frame_count = all_frames) {
+        source_type source;
+        if (!this->open_source(path, source)) {
+            return false;
+        }
+        for (size_t stream = 0; stream < source.video->get_streams(); ++stream) {
+            const unsigned long long int stream_frames = source.video->get_frame_count(stream);
+            const unsigned long long int first = (first_frame < stream_frames) ? first_frame : stream_frames;
+            const unsigned long long int count = (frame_count < stream_frames - first) ? frame_count : stream_frames - first;
+            source.first_frames.push_back(first);
+            source.end_frames.push_back(first + count);
+        }
+        this->sources.push_back(std::move(source));
+        return true;
+    }
+
+    // Add the frames of a file shown between two times in seconds, including the frames partly shown at either end.
+    bool add_time(const char* path, double start_seconds, double end_seconds) {
+        source_type source;
+        if (!this->open_source(path, source)) {
+            return false;
+        }
+        for (size_t stream = 0; stream < source.video->get_streams(); ++stream) {
+            unsigned long long int first = source.video->get_frame_number(stream, start_seconds);
+            unsigned long long int end = source.video->get_frame_number(stream, end_seconds);
+            // The frame shown at the end time is only included when it starts before the end.
+            if ((source.video->get_frame_count(stream) > 0) && (source.video->get_frame_time(stream, end) + 1e-6 < end_seconds)) {
+                end += 1;
+            }
+            first = (first < end) ? first : end;
+            source.first_frames.push_back(first);
+            source.end_frames.push_back(end);
+        }
+        this->sources.push_back(std::move(source));
+        return true;
+    }
+
+    // Write the ranges added to a new file, in the order they were added, the file is removed if anything fails.
+    bool write(const char* path, unsigned long long int segment_size = avi::default_segment_size) {
+        if (this->sources.empty()) {
+            std::fprintf(stderr, "Error: Nothing to remux.\n");
+            return false;
+        }
+
+        // The headers come from the first source, the writer fills in the lengths.
+        const avi& first_video = *this->sources.front().video;
+        avi::avih_type avih = *first_video.get_avih();
+        std::vector<avi::stream_type> streams(first_video.get_streams());
+        for (size_t stream = 0; stream < streams.size(); ++stream) {
+            streams[stream].strh = first_video.get_stream(stream).strh;
+            streams[stream].strf_vids = first_video.get_stream(stream).strf_vids;
+        }
+        avi_writer writer;
+        if (!writer.open(path, &avih, streams, segment_size)) {
+            return false;
+        }
+
+        bool success = true;
+        for (size_t index_source = 0; (success) && (index_source < this->sources.size()); ++index_source) {
+            const source_type& source = this->sources[index_source];
+            avi::file_type file;
+            if (!avi::open_file(source.path.c_str(), avi::access_type::sequential, true, file)) {
+                success = false;
+                break;
+            }
+
+            // Interleave the streams a frame at a time.
+            unsigned long long int longest_range = 0;
+            for (size_t stream = 0; stream < streams.size(); ++stream) {
+                const unsigned long long int range = source.end_frames[stream] - source.first_frames[stream];
+                longest_range = (range > longest_range) ? range : longest_range;
+            }
+            for (unsigned long long int index_frame = 0; (success) && (index_frame < longest_range); ++index_frame) {
+                for (size_t stream = 0; (success) && (stream < streams.size()); ++stream) {
+                    const unsigned long long int frame_number = source.first_frames[stream] + index_frame;
+                    if (frame_number >= source.end_frames[stream]) {
+                        continue;
+                    }
+                    avi::frame_type frame;
+                    success = (source.video->get_frame(stream, frame_number, frame)) && (writer.copy_frame(static_cast<unsigned int>(stream), file, source.video->get_frame_offset(frame), frame.length, source.video->is_frame_uncompressed(frame)));
+                }
+            }
+
+            avi::close_file(file);
+        }
+
+        success = writer.close() && success;
+        if (!success) {
+            std::fprintf(stderr, "Error: Failed to remux into file '%s'.\n", path);
+            std::remove(path);
+        }
+        return success;
+    }
+
+    // Remove all the sources added.
+    void clear() {
+        this->sources.clear();
+    }
+
+private:
+    // Open a source without loading its frames and check it can be joined to the sources already added.
+    bool open_source(const char* path, source_type& source) const {
+        if (path == nullptr) {
+            return false;
+        }
+        source.path = path;
+        source.video.reset(new avi());
+        if (!source.video->open(path, avi::access_type::random, false)) {
+            return false;
+        }
+        for (size_t stream = 0; stream < source.video->get_streams(); ++stream) {
+            if (source.video->get_stream(stream).strf_vids == nullptr) {
+                std::fprintf(stderr, "Error: Only video streams can be remuxed, file '%s' has other streams.\n", path);
+                return false;
+            }
+        }
+        if (this->sources.empty()) {
+            return true;
+        }
+
+        const avi& first_video = *this->sources.front().video;
+        bool compatible = (source.video->get_streams() == first_video.get_streams());
+        for (size_t stream = 0; (compatible) && (stream < first_video.get_streams()); ++stream) {
+            const avi::stream_type& first_stream = first_video.get_stream(stream);
+            const avi::stream_type& other_stream = source.video->get_stream(stream);
+            compatible = (other_stream.strh->type == first_stream.strh->type) && (other_stream.strh->handler == first_stream.strh->handler);
+            compatible = compatible && (other_stream.strh->scale == first_stream.strh->scale) && (other_stream.strh->rate == first_stream.strh->rate);
+            compatible = compatible && (other_stream.strf_vids->header_size == first_stream.strf_vids->header_size);
+            const unsigned char* first_strf_vids = reinterpret_cast<const unsigned char*>(first_stream.strf_vids);
+            const unsigned char* other_strf_vids = reinterpret_cast<const unsigned char*>(other_stream.strf_vids);
+            for (unsigned int byte = 0; (compatible) && (byte < first_stream.strf_vids->header_size); ++byte) {
+                compatible = (other_strf_vids[byte] == first_strf_vids[byte]);
+            }
+        }
+        if (!compatible) {
+            std::fprintf(stderr, "Error: File '%s' does not have the same streams, strf_vids headers and frame rates as file '%s'.\n", path, this->sources.front().path.c_str());
+            return false;
+        }
+        return true;
+    }
+};
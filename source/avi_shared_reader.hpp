@@ -0,0 +1,179 @@
+#pragma once
+
+#include "avi.hpp"
+
+#include <cstdio>
+#include <vector>
+
+// Shares one opened avi between any number of threads.
+// Opening parses the file once into an index of the offset and length of every frame, which is never changed until the reader is closed.
+// Frames are then read with pread into buffers owned by the caller, so every const member can be called from any thread without locking.
+// Each thread can instead keep its own cursor, which reads the frames of a stream in turn into a buffer of its own.
+class avi_shared_reader final {
+private:
+    struct location_type {
+        unsigned long long int offset;
+        unsigned long long int length;
+    };
+
+private:
+    avi video;
+    avi::file_type file;
+    // The frames of each stream.
+    std::vector<std::vector<location_type>> locations;
+
+public:
+    avi_shared_reader()
+        : video()
+#if defined(_WIN32)
+        , file(INVALID_HANDLE_VALUE)
+#else
+        , file(-1)
+#endif
+        , locations() {
+    }
+
+    ~avi_shared_reader() {
+        this->close();
+    }
+
+    avi_shared_reader(const avi_shared_reader&) = delete;
+    avi_shared_reader& operator=(const avi_shared_reader&) = delete;
+
+public:
+    // Open and index a file, this and close must not be called while other threads are reading.
+    bool open(const char* path) {
+        this->close();
+
+        if (!this->video.open(path, avi::access_type::random, false)) {
+            return false;
+        }
+
+        if (!avi::open_file(path, avi::access_type::random, true, this->file)) {
+            this->close();
+            return false;
+        }
+
+        this->locations.resize(this->video.get_streams());
+        for (size_t stream = 0; stream < this->locations.size(); ++stream) {
+            this->locations[stream].resize(static_cast<size_t>(this->video.get_frame_count(stream)));
+            for (size_t frame_number = 0; frame_number < this->locations[stream].size(); ++frame_number) {
+                avi::frame_type frame;
+                if (!this->video.get_frame(stream, frame_number, frame)) {
+                    this->close();
+                    return false;
+                }
+                this->locations[stream][frame_number].offset = this->video.get_frame_offset(frame);
+                this->locations[stream][frame_number].length = frame.length;
+            }
+        }
+        return true;
+    }
+
+    void close() {
+        avi::close_file(this->file);
+        this->video.close();
+        this->locations.clear();
+    }
+
+    bool is_open() const {
+#if defined(_WIN32)
+        return (this->file != INVALID_HANDLE_VALUE);
+#else
+        return (this->file >= 0);
+#endif
+    }
+
+    // The parsed file, for its headers and the strf_vids of each stream.
+    const avi& get_avi() const {
+        return this->video;
+    }
+
+    size_t get_streams() const {
+        return this->locations.size();
+    }
+
+    unsigned long long int get_frame_count(size_t stream) const {
+        return (stream < this->locations.size()) ? this->locations[stream].size() : 0;
+    }
+
+    // Length of a frame, the size of buffer needed to read it, or zero when the frame does not exist.
+    unsigned long long int get_frame_length(size_t stream, unsigned long long int frame_number) const {
+        if (frame_number >= this->get_frame_count(stream)) {
+            return 0;
+        }
+        return this->locations[stream][static_cast<size_t>(frame_number)].length;
+    }
+
+public:
+    // Read a frame into a buffer owned by the caller, which must hold at least get_frame_length bytes.
+    bool read_frame(size_t stream, unsigned long long int frame_number, unsigned char* buffer, unsigned long long int buffer_length, unsigned long long int& frame_length) const {
+        if (frame_number >= this->get_frame_count(stream)) {
+            std::fprintf(stderr, "Error: Failed to read frame %llu of stream %zu, the frame does not exist.\n", frame_number, stream);
+            return false;
+        }
+        const location_type& location = this->locations[stream][static_cast<size_t>(frame_number)];
+        if (location.length > buffer_length) {
+            std::fprintf(stderr, "Error: Failed to read frame %llu of stream %zu, the buffer is too small.\n", frame_number, stream);
+            return false;
+        }
+        if (!this->read_at(location.offset, buffer, location.length)) {
+            std::fprintf(stderr, "Error: Failed to read frame %llu of stream %zu.\n", frame_number, stream);
+            return false;
+        }
+        frame_length = location.length;
+        return true;
+    }
+
+    // Read a frame into a vector owned by the caller, resizing it to the length of the frame.
+    bool read_frame(size_t stream, unsigned long long int frame_number, std::vector<unsigned char>& buffer) const {
+        buffer.resize(static_cast<size_t>(this->get_frame_length(stream, frame_number)));
+        unsigned long long int frame_length = 0;
+        return this->read_frame(stream, frame_number, buffer.data(), buffer.size(), frame_length);
+    }
+
+public:
+    // Position of a single thread in a stream of a shared reader, frames are read into a buffer owned by the cursor.
+    class cursor_type final {
+    private:
+        const avi_shared_reader* reader;
+        size_t stream;
+        unsigned long long int next_frame;
+        std::vector<unsigned char> buffer;
+
+    public:
+        cursor_type(const avi_shared_reader& shared_reader, size_t stream_index, unsigned long long int first_frame = 0)
+            : reader(&shared_reader)
+            , stream(stream_index)
+            , next_frame(first_frame)
+            , buffer() {
+        }
+
+        void seek(unsigned long long int frame_number) {
+            this->next_frame = frame_number;
+        }
+
+        unsigned long long int tell() const {
+            return this->next_frame;
+        }
+
+        // Read the next frame, the data stays valid until the cursor reads again, fails at the end of the stream.
+        bool next(avi::frame_type& frame) {
+            if (this->next_frame >= this->reader->get_frame_count(this->stream)) {
+                return false;
+            }
+            if (!this->reader->read_frame(this->stream, this->next_frame, this->buffer)) {
+                return false;
+            }
+            frame.data = this->buffer.data();
+            frame.length = this->buffer.size();
+            this->next_frame += 1;
+            return true;
+        }
+    };
+
+private:
+    bool read_at(unsigned long long int position, unsigned char* data, unsigned long long int length) const {
+        return avi::read_at(this->file, position, data, length) == length;
+    }
+};
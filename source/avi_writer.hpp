@@ -0,0 +1,902 @@
+#pragma once
+
+#include "avi.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+    #if !defined(NOMINMAX)
+        #define NOMINMAX
+    #endif
+    #if !defined(WIN32_LEAN_AND_MEAN)
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Writes an OpenDML avi to a file one frame at a time, the layout matches that of avi::compose.
+// The headers are written with placeholder sizes when the file is opened, frames are appended as they arrive and the sizes and indexes are filled in on close.
+// Only the index entries of the current RIFF chunk are held in memory, so memory use does not grow with the length of the file.
+// Checkpoints make the file on disk a complete avi of the frames written so far, so if the writer dies the file can still be read up to the last one.
+// With direct I/O the file bypasses the page cache, appends are staged in two aligned buffers and an I/O thread writes one while the other fills.
+class avi_writer final {
+public:
+    // Space reserved in each indx super index, one entry is used per RIFF chunk containing frames of the stream.
+    constexpr static const unsigned int default_super_index_capacity = 256;
+    // Size of each of the two staging buffers used with direct I/O, a multiple of the direct I/O alignment.
+    constexpr static const unsigned long long int staging_size = 0x00800000;
+
+    enum class io_type {
+        // Written through the page cache.
+        buffered,
+        // Written with O_DIRECT or FILE_FLAG_NO_BUFFERING, falling back to buffered when the file system rejects it.
+        direct
+    };
+
+    using file_type = avi::file_type;
+
+private:
+    file_type file;
+    bool failed;
+    unsigned long long int segment_size;
+    unsigned int super_index_capacity;
+    unsigned int frame_alignment;
+    // Offsets of fields patched on close.
+    unsigned long long int avih_offset;
+    unsigned long long int dmlh_offset;
+    std::vector<unsigned long long int> strh_offsets;
+    std::vector<unsigned long long int> super_index_offsets;
+    avi::avih_type avih;
+    std::vector<avi::strh_type> strhs;
+    size_t video_stream;
+    // Index entries of every stream, only the standard index entries of the current RIFF chunk are kept.
+    std::vector<std::vector<avi::super_index_entry_type>> super_index_entries;
+    std::vector<std::vector<avi::standard_index_entry_type>> standard_index_entries;
+    std::vector<avi::index_type> indexes;
+    std::vector<unsigned int> stream_frames;
+    // The RIFF chunk being written.
+    unsigned int segment;
+    unsigned long long int riff_offset;
+    unsigned long long int movi_offset;
+    unsigned long long int segment_frame_bytes;
+    unsigned int first_segment_frames;
+    unsigned long long int offset;
+    // Staging for frames copied from another file when the kernel cannot copy them directly.
+    std::vector<unsigned char> copy_buffer;
+    // The zeros of the JUNK chunks that align frames.
+    std::vector<unsigned char> alignment_buffer;
+    // Bytes written between syncs, independent of checkpoints, zero to only sync at checkpoints and on close.
+    unsigned long long int sync_interval;
+    unsigned long long int unsynced_bytes;
+    // Bytes written between checkpoints, zero for none.
+    unsigned long long int checkpoint_interval;
+    unsigned long long int checkpoint_offset;
+    // The standard indexes written by the last checkpoint in the current RIFF chunk.
+    std::vector<unsigned long long int> checkpoint_indexes;
+    // Standard indexes that have been replaced, renamed to JUNK once the headers no longer point at them.
+    std::vector<unsigned long long int> stale_indexes;
+    bool idx1_written;
+    // Direct I/O, the file above is still used for the sizes and indexes patched into data already written.
+    bool direct;
+    file_type direct_file;
+    std::vector<unsigned char> staging;
+    unsigned char* staging_buffers[2];
+    size_t staging_index;
+    // Offset in the file of the buffer being filled, and the bytes in it.
+    unsigned long long int staging_offset;
+    unsigned long long int staging_length;
+    std::thread thread;
+    // Everything below is shared with the I/O thread.
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+    // The buffer being written by the I/O thread, none when the length is zero.
+    const unsigned char* pending_data;
+    unsigned long long int pending_offset;
+    unsigned long long int pending_length;
+    bool pending_failed;
+    // Set by the I/O thread once a direct write is rejected, the rest of the file is then written through the page cache.
+    bool direct_rejected;
+
+public:
+    avi_writer()
+#if defined(_WIN32)
+        : file(INVALID_HANDLE_VALUE)
+#else
+        : file(-1)
+#endif
+        , failed(false)
+        , segment_size(avi::default_segment_size)
+        , super_index_capacity(default_super_index_capacity)
+        , frame_alignment(1)
+        , avih_offset(0)
+        , dmlh_offset(0)
+        , strh_offsets()
+        , super_index_offsets()
+        , avih{}
+        , strhs()
+        , video_stream(0)
+        , super_index_entries()
+        , standard_index_entries()
+        , indexes()
+        , stream_frames()
+        , segment(0)
+        , riff_offset(0)
+        , movi_offset(0)
+        , segment_frame_bytes(0)
+        , first_segment_frames(0)
+        , offset(0)
+        , copy_buffer()
+        , alignment_buffer()
+        , sync_interval(0)
+        , unsynced_bytes(0)
+        , checkpoint_interval(0)
+        , checkpoint_offset(0)
+        , checkpoint_indexes()
+        , stale_indexes()
+        , idx1_written(false)
+        , direct(false)
+#if defined(_WIN32)
+        , direct_file(INVALID_HANDLE_VALUE)
+#else
+        , direct_file(-1)
+#endif
+        , staging()
+        , staging_buffers{ nullptr, nullptr }
+        , staging_index(0)
+        , staging_offset(0)
+        , staging_length(0)
+        , thread()
+        , mutex()
+        , condition()
+        , stopping(false)
+        , pending_data(nullptr)
+        , pending_offset(0)
+        , pending_length(0)
+        , pending_failed(false)
+        , direct_rejected(false) {
+    }
+
+    ~avi_writer() {
+        this->close();
+    }
+
+    avi_writer(const avi_writer&) = delete;
+    avi_writer& operator=(const avi_writer&) = delete;
+
+public:
+    // Create the file and write its headers, only the strh and strf_vids of each stream are used and they are copied.
+    // The avih total frames and strh lengths are filled in on close.
+    // With a frame alignment above one the data of every frame starts on a multiple of it, as with avi::compose.
+    // After every file_checkpoint_interval bytes, at the end of a frame, the sizes, headers and indexes are brought up to date and synced to disk.
+    // Data is synced before the headers that point at it, so a checkpoint never refers to frames that were lost.
+    // Without checkpoints the file is still synced after every file_sync_interval bytes, so writing never runs far ahead of the disk.
+    bool open(
+        const char* path,
+        const avi::avih_type* avih_data,
+        const std::vector<avi::stream_type>& streams,
+        unsigned long long int riff_segment_size = avi::default_segment_size,
+        unsigned int riff_super_index_capacity = default_super_index_capacity,
+        unsigned int alignment = 1,
+        io_type io = io_type::buffered,
+        unsigned long long int file_checkpoint_interval = 0,
+        unsigned long long int file_sync_interval = 0
+    ) {
+        this->close();
+
+        if ((path == nullptr) || (avih_data == nullptr) || (streams.empty()) || (streams.size() > 255) || (riff_super_index_capacity == 0) || (alignment == 0) || (alignment & (alignment - 1))) {
+            std::fprintf(stderr, "Error: Invalid avi writer configuration.\n");
+            return false;
+        }
+        for (const avi::stream_type& stream : streams) {
+            if ((stream.strh == nullptr) || (stream.strf_vids == nullptr)) {
+                std::fprintf(stderr, "Error: Only video streams can be written.\n");
+                return false;
+            }
+        }
+
+#if defined(_WIN32)
+        // Readers can follow the file as it is written, and direct I/O opens it a second time for writing.
+        this->file = CreateFileA(path, GENERIC_WRITE, (io == io_type::direct) ? (FILE_SHARE_READ | FILE_SHARE_WRITE) : FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (this->file == INVALID_HANDLE_VALUE) {
+            std::fprintf(stderr, "Error: Failed to create file '%s'.\n", path);
+            return false;
+        }
+#else
+        this->file = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (this->file < 0) {
+            std::fprintf(stderr, "Error: Failed to create file '%s'.\n", path);
+            return false;
+        }
+#endif
+        this->sync_interval = file_sync_interval;
+        this->unsynced_bytes = 0;
+        this->checkpoint_interval = file_checkpoint_interval;
+        this->checkpoint_offset = 0;
+        this->checkpoint_indexes.clear();
+        this->stale_indexes.clear();
+        this->idx1_written = false;
+        if ((io == io_type::direct) && (!this->begin_direct(path))) {
+            std::fprintf(stderr, "Warning: Direct I/O is not supported for file '%s', writing through the page cache.\n", path);
+        }
+
+        this->failed = false;
+        this->segment_size = riff_segment_size;
+        this->super_index_capacity = riff_super_index_capacity;
+        this->frame_alignment = alignment;
+        this->alignment_buffer.assign((alignment > 1) ? (alignment + 6) : 0, 0);
+        this->avih = *avih_data;
+        this->strhs.clear();
+        for (size_t stream = 0; stream < streams.size(); ++stream) {
+            this->strhs.push_back(*streams[stream].strh);
+        }
+        this->video_stream = avi::find_video_stream(streams);
+        this->super_index_entries.assign(streams.size(), {});
+        this->standard_index_entries.assign(streams.size(), {});
+        this->indexes.clear();
+        this->stream_frames.assign(streams.size(), 0);
+        this->segment = 0;
+        this->first_segment_frames = 0;
+
+        // RIFF[AVI ]->LIST[hdrl] as avi::compose lays it out, the headers and indexes are rewritten on close.
+        std::vector<unsigned char> header;
+        const unsigned long long int riff_length_offset = avi::begin_chunk(header, "RIFF", "AVI ");
+        const avi::avih_type avih_written = avi::compose_avih(this->avih, this->frame_alignment, false, 0);
+        avi::header_list_layout_type layout;
+        avi::compose_header_list(avih_written, streams, std::vector<unsigned int>(streams.size(), this->super_index_capacity), 0, header, layout);
+        this->avih_offset = layout.avih_offset;
+        this->strh_offsets = layout.strh_offsets;
+        this->super_index_offsets = layout.super_index_offsets;
+        this->dmlh_offset = layout.dmlh_offset;
+
+        this->offset = 0;
+        this->riff_offset = riff_length_offset;
+        if ((!this->write(header.data(), header.size())) || (!this->begin_movi())) {
+            this->failed = true;
+            this->close();
+            return false;
+        }
+        return true;
+    }
+
+    // Append a frame to a stream, starting a new RIFF[AVIX] chunk when the current one is full.
+    // Uncompressed frames, such as those stored by huffyuv::encode, are written as '##db' chunks rather than '##dc'.
+    bool write_frame(unsigned int stream, const unsigned char* data, unsigned long long int length, bool uncompressed = false) {
+        return this->append_frame(stream, length, uncompressed, [&]() {
+            return this->write(data, length);
+        });
+    }
+
+    // Append a frame to a stream copied straight from another file open for reading, the data never passes through user space where the platform allows.
+    bool copy_frame(unsigned int stream, file_type source, unsigned long long int source_offset, unsigned long long int length, bool uncompressed = false) {
+        return this->append_frame(stream, length, uncompressed, [&]() {
+            return this->copy_from(source, source_offset, length);
+        });
+    }
+
+    // Write the indexes and fill in the sizes, returns false if anything failed to be written.
+    bool close() {
+        if (!this->is_open()) {
+            return false;
+        }
+
+        bool success = !this->failed;
+        if (success) {
+            success = this->end_segment() && this->write_headers() && ((this->checkpoint_interval == 0) || (this->commit())) && (this->remove_stale_indexes());
+        }
+        if (this->direct) {
+            success = this->end_direct(success) && success;
+        }
+        else if ((success) && ((this->checkpoint_interval > 0) || (this->sync_interval > 0))) {
+            success = this->sync();
+        }
+
+#if defined(_WIN32)
+        success = (CloseHandle(this->file) != 0) && success;
+        this->file = INVALID_HANDLE_VALUE;
+#else
+        success = (::close(this->file) == 0) && success;
+        this->file = -1;
+#endif
+        this->super_index_entries.clear();
+        this->standard_index_entries.clear();
+        this->indexes.clear();
+        return success;
+    }
+
+    bool is_open() const {
+#if defined(_WIN32)
+        return (this->file != INVALID_HANDLE_VALUE);
+#else
+        return (this->file >= 0);
+#endif
+    }
+
+private:
+    // Write a frame chunk, with the frame data written by write_data, and add it to the indexes.
+    template <typename write_data_type>
+    bool append_frame(unsigned int stream, unsigned long long int length, bool uncompressed, const write_data_type& write_data) {
+        if ((!this->is_open()) || (this->failed)) {
+            return false;
+        }
+        if (stream >= this->stream_frames.size()) {
+            std::fprintf(stderr, "Error: Invalid stream number to write a frame to.\n");
+            return false;
+        }
+        if (length > avi::max_frame_length) {
+            std::fprintf(stderr, "Error: Frame is too large to store in a chunk.\n");
+            return false;
+        }
+
+        // Room is left for the most padding aligning the frame can take, so RIFF chunks are split where avi::compose splits them.
+        const unsigned long long int chunk_size = this->alignment_buffer.size() + 8 + length + (length % 2);
+        if ((this->segment_frame_bytes > 0) && (this->segment_frame_bytes + chunk_size > this->segment_size)) {
+            if ((!this->end_segment()) || (!this->begin_segment())) {
+                this->failed = true;
+                return false;
+            }
+        }
+        if ((this->frame_alignment > 1) && (!this->write_alignment())) {
+            this->failed = true;
+            return false;
+        }
+
+        const unsigned int chunk_length = static_cast<unsigned int>(length);
+        const unsigned long long int chunk_offset = this->offset;
+        unsigned char chunk_header[8];
+        avi::frame_chunk_id(stream, uncompressed, &chunk_header[0]);
+        std::memcpy(&chunk_header[4], &chunk_length, 4);
+        const unsigned char padding = 0;
+        if ((!this->write(chunk_header, 8)) || (!write_data()) || ((length % 2) && (!this->write(&padding, 1)))) {
+            this->failed = true;
+            return false;
+        }
+
+        // Every frame is a keyframe, so the top bit of the size is never set.
+        avi::standard_index_entry_type standard_index_entry;
+        standard_index_entry.offset = static_cast<unsigned int>(chunk_offset + 8 - (this->movi_offset - 4));
+        standard_index_entry.size = chunk_length;
+        this->standard_index_entries[stream].push_back(standard_index_entry);
+        if (this->segment == 0) {
+            // Offsets are relative to the LIST[movi] form, every frame is a keyframe.
+            avi::index_type index;
+            std::memcpy(&index.chunk_id, &chunk_header[0], 4);
+            index.flags = avi::index_flag_keyframe;
+            index.offset = static_cast<unsigned int>(chunk_offset - (this->movi_offset + 4));
+            index.size = chunk_length;
+            this->indexes.push_back(index);
+            if (stream == this->video_stream) {
+                ++this->first_segment_frames;
+            }
+        }
+        this->segment_frame_bytes += chunk_size;
+        ++this->stream_frames[stream];
+
+        if ((this->checkpoint_interval > 0) && (this->offset - this->checkpoint_offset >= this->checkpoint_interval) && (!this->checkpoint())) {
+            this->failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    // Make the file on disk a complete avi of the frames written so far.
+    // The frames of the current RIFF chunk are indexed by a standard index written after them.
+    // Only once that is on disk are the chunk sizes filled in up to it and the headers updated to point at it.
+    // Only once they are on disk is the index of the last checkpoint retired.
+    // Costs the standard index of the current RIFF chunk, rewritten in full, and two syncs.
+    bool checkpoint() {
+        this->stale_indexes.insert(this->stale_indexes.end(), this->checkpoint_indexes.begin(), this->checkpoint_indexes.end());
+        this->checkpoint_indexes.clear();
+
+        std::vector<size_t> indexed_streams;
+        for (size_t stream = 0; stream < this->standard_index_entries.size(); ++stream) {
+            if (this->standard_index_entries[stream].empty()) {
+                continue;
+            }
+            avi::super_index_entry_type super_index_entry;
+            if (!this->write_standard_index(stream, super_index_entry)) {
+                return false;
+            }
+            this->checkpoint_indexes.push_back(super_index_entry.offset);
+            this->super_index_entries[stream].push_back(super_index_entry);
+            indexed_streams.push_back(stream);
+        }
+        if ((!this->commit()) || (!this->patch_length(this->movi_offset, this->offset)) || (!this->patch_length(this->riff_offset, this->offset))) {
+            return false;
+        }
+
+        // The standard indexes are only listed by the super indexes until the next checkpoint or the end of the RIFF chunk.
+        const bool headers_written = this->write_headers();
+        for (const size_t stream : indexed_streams) {
+            this->super_index_entries[stream].pop_back();
+        }
+        if ((!headers_written) || (!this->commit()) || (!this->remove_stale_indexes())) {
+            return false;
+        }
+        this->checkpoint_offset = this->offset;
+        return true;
+    }
+
+    // Get everything written so far on to the disk.
+    bool commit() {
+        if ((this->direct) && (!this->flush_staging())) {
+            return false;
+        }
+        return this->sync();
+    }
+
+    bool remove_stale_indexes() {
+        for (const unsigned long long int index_offset : this->stale_indexes) {
+            if (!this->write_at(index_offset, "JUNK", 4)) {
+                return false;
+            }
+        }
+        this->stale_indexes.clear();
+        return true;
+    }
+
+    // Write a JUNK chunk so the data of the next chunk starts on a multiple of the frame alignment, the padding is never shorter than a chunk header.
+    bool write_alignment() {
+        unsigned long long int padding = (this->frame_alignment - ((this->offset + 8) % this->frame_alignment)) % this->frame_alignment;
+        while ((padding > 0) && (padding < 8)) {
+            padding += this->frame_alignment;
+        }
+        if (padding == 0) {
+            return true;
+        }
+        const unsigned int junk_length = static_cast<unsigned int>(padding - 8);
+        unsigned char junk_header[8] = { 'J', 'U', 'N', 'K', 0, 0, 0, 0 };
+        std::memcpy(&junk_header[4], &junk_length, 4);
+        return (this->write(junk_header, 8)) && (this->write(this->alignment_buffer.data(), junk_length));
+    }
+
+    bool begin_segment() {
+        // RIFF[AVIX]
+        ++this->segment;
+        const unsigned char riff_header[12] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'A', 'V', 'I', 'X' };
+        this->riff_offset = this->offset + 4;
+        if (!this->write(riff_header, 12)) {
+            return false;
+        }
+        return this->begin_movi();
+    }
+
+    bool begin_movi() {
+        const unsigned char movi_header[12] = { 'L', 'I', 'S', 'T', 0, 0, 0, 0, 'm', 'o', 'v', 'i' };
+        this->movi_offset = this->offset + 4;
+        this->segment_frame_bytes = 0;
+        return this->write(movi_header, 12);
+    }
+
+    bool end_segment() {
+        // The indexes of the last checkpoint are replaced by those of the whole RIFF chunk.
+        this->stale_indexes.insert(this->stale_indexes.end(), this->checkpoint_indexes.begin(), this->checkpoint_indexes.end());
+        this->checkpoint_indexes.clear();
+
+        // LIST[movi]->ix##
+        for (size_t stream = 0; stream < this->standard_index_entries.size(); ++stream) {
+            if (this->standard_index_entries[stream].empty()) {
+                continue;
+            }
+            avi::super_index_entry_type super_index_entry;
+            if (!this->write_standard_index(stream, super_index_entry)) {
+                return false;
+            }
+            this->super_index_entries[stream].push_back(super_index_entry);
+            this->standard_index_entries[stream].clear();
+        }
+
+        const unsigned long long int movi_end = this->offset;
+
+        // RIFF[AVI ]->idx1
+        if (this->segment == 0) {
+            const unsigned long long int idx1_length = this->indexes.size() * sizeof(avi::index_type);
+            if (idx1_length > 0xFFFFFFFF) {
+                std::fprintf(stderr, "Error: Failed to write avi, 'idx1' chunk is too large.\n");
+                return false;
+            }
+            const unsigned int chunk_length = static_cast<unsigned int>(idx1_length);
+            unsigned char idx1_header[8] = { 'i', 'd', 'x', '1', 0, 0, 0, 0 };
+            std::memcpy(&idx1_header[4], &chunk_length, 4);
+            if ((!this->write(idx1_header, 8)) || (!this->write(this->indexes.data(), idx1_length))) {
+                return false;
+            }
+            this->indexes.clear();
+            this->indexes.shrink_to_fit();
+            this->idx1_written = true;
+        }
+
+        // With checkpoints the data is on disk before the sizes that take it in, so a RIFF chunk never runs past the end of the file.
+        if ((this->checkpoint_interval > 0) && (!this->commit())) {
+            return false;
+        }
+        return (this->patch_length(this->movi_offset, movi_end)) && (this->patch_length(this->riff_offset, this->offset));
+    }
+
+    // Write the standard index of the frames of a stream in the current RIFF chunk, giving the super index entry for it.
+    bool write_standard_index(size_t stream, avi::super_index_entry_type& super_index_entry) {
+        const std::vector<avi::standard_index_entry_type>& entries = this->standard_index_entries[stream];
+        if (this->super_index_entries[stream].size() == this->super_index_capacity) {
+            std::fprintf(stderr, "Error: Too many RIFF chunks for the space reserved in the super index.\n");
+            return false;
+        }
+
+        const avi::standard_index_type standard_index = avi::standard_index_header(static_cast<unsigned int>(stream), static_cast<unsigned int>(entries.size()), this->movi_offset - 4);
+        const unsigned int ix_length = static_cast<unsigned int>(sizeof(avi::standard_index_type) + entries.size() * sizeof(avi::standard_index_entry_type));
+        unsigned char ix_header[8];
+        avi::index_chunk_id(static_cast<unsigned int>(stream), &ix_header[0]);
+        std::memcpy(&ix_header[4], &ix_length, 4);
+
+        super_index_entry.offset = this->offset;
+        super_index_entry.size = 8 + ix_length;
+        super_index_entry.duration = static_cast<unsigned int>(entries.size());
+
+        return (this->write(ix_header, 8)) && (this->write(&standard_index, sizeof(avi::standard_index_type))) && (this->write(entries.data(), entries.size() * sizeof(avi::standard_index_entry_type)));
+    }
+
+    bool write_headers() {
+        // Only the frames of the first RIFF chunk are counted by avih when the file is split.
+        // Until the first RIFF chunk is finished there is no idx1 index to advertise.
+        const avi::avih_type avih_data = avi::compose_avih(this->avih, this->frame_alignment, this->idx1_written, (this->segment > 0) ? this->first_segment_frames : this->stream_frames[this->video_stream]);
+        if (!this->write_at(this->avih_offset, &avih_data, sizeof(avi::avih_type))) {
+            return false;
+        }
+        if (!this->write_at(this->dmlh_offset, &this->stream_frames[this->video_stream], 4)) {
+            return false;
+        }
+
+        for (size_t stream = 0; stream < this->strhs.size(); ++stream) {
+            avi::strh_type strh = this->strhs[stream];
+            strh.length = this->stream_frames[stream];
+            if (!this->write_at(this->strh_offsets[stream], &strh, sizeof(avi::strh_type))) {
+                return false;
+            }
+
+            const avi::super_index_type super_index = avi::super_index_header(static_cast<unsigned int>(stream), static_cast<unsigned int>(this->super_index_entries[stream].size()));
+            if (
+                (!this->write_at(this->super_index_offsets[stream], &super_index, sizeof(avi::super_index_type))) ||
+                (!this->write_at(this->super_index_offsets[stream] + sizeof(avi::super_index_type), this->super_index_entries[stream].data(), this->super_index_entries[stream].size() * sizeof(avi::super_index_entry_type)))
+            ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Fill in the length of the chunk whose length field is at the offset, from the end of the chunk.
+    bool patch_length(unsigned long long int length_offset, unsigned long long int end_offset) {
+        const unsigned long long int length = end_offset - length_offset - 4;
+        if (length > 0xFFFFFFFF) {
+            std::fprintf(stderr, "Error: Failed to write avi, chunk is too large.\n");
+            return false;
+        }
+        const unsigned int chunk_length = static_cast<unsigned int>(length);
+        return this->write_at(length_offset, &chunk_length, 4);
+    }
+
+    // Append to the end of the file.
+    bool write(const void* data, unsigned long long int length) {
+        if (this->direct) {
+            if (!this->stage(data, length)) {
+                return false;
+            }
+            this->offset += length;
+            return true;
+        }
+        if (!this->write_at(this->offset, data, length)) {
+            return false;
+        }
+        this->offset += length;
+        return this->count_unsynced(length);
+    }
+
+    // Write over data already appended, with direct I/O the data may still be staged.
+    bool write_at(unsigned long long int position, const void* data, unsigned long long int length) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        if ((this->direct) && (position + length > this->staging_offset)) {
+            const unsigned long long int staged_position = (position > this->staging_offset) ? position : this->staging_offset;
+            std::memcpy(this->staging_buffers[this->staging_index] + (staged_position - this->staging_offset), bytes + (staged_position - position), static_cast<size_t>(position + length - staged_position));
+            length = staged_position - position;
+        }
+        if (length == 0) {
+            return true;
+        }
+        // The data is already on disk, or about to be, and is patched through the page cache once the I/O thread is done with it.
+        if ((this->direct) && (!this->wait_staging())) {
+            return false;
+        }
+        if (!write_file(this->file, position, bytes, length)) {
+            std::fprintf(stderr, "Error: Failed to write to avi file.\n");
+            return false;
+        }
+        return true;
+    }
+
+    // Count bytes appended through the page cache, syncing each time the sync interval is reached.
+    bool count_unsynced(unsigned long long int length) {
+        this->unsynced_bytes += length;
+        if ((this->sync_interval == 0) || (this->unsynced_bytes < this->sync_interval)) {
+            return true;
+        }
+        this->unsynced_bytes = 0;
+        return this->sync();
+    }
+
+    // Flush written data to disk, dropping it from the page cache where the platform allows as it will not be read again soon.
+    bool sync() {
+#if defined(_WIN32)
+        if (!FlushFileBuffers(this->file)) {
+            std::fprintf(stderr, "Error: Failed to sync avi file.\n");
+            return false;
+        }
+#elif defined(__APPLE__)
+        // There is no fdatasync, and fsync does not flush the drive cache, not every file system supports F_FULLFSYNC.
+        if ((fcntl(this->file, F_FULLFSYNC) != 0) && (fsync(this->file) != 0)) {
+            std::fprintf(stderr, "Error: Failed to sync avi file.\n");
+            return false;
+        }
+#else
+        if (fdatasync(this->file) != 0) {
+            std::fprintf(stderr, "Error: Failed to sync avi file.\n");
+            return false;
+        }
+    #if defined(POSIX_FADV_DONTNEED)
+        posix_fadvise(this->file, 0, 0, POSIX_FADV_DONTNEED);
+    #endif
+#endif
+        return true;
+    }
+
+private:
+    // Open the file a second time for direct I/O and start the I/O thread, fails when the file system does not support it.
+    bool begin_direct(const char* path) {
+#if defined(_WIN32)
+        this->direct_file = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH, nullptr);
+        if (this->direct_file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+#elif defined(O_DIRECT)
+        this->direct_file = ::open(path, O_WRONLY | O_DIRECT);
+        if (this->direct_file < 0) {
+            return false;
+        }
+#else
+        static_cast<void>(path);
+        return false;
+#endif
+
+        this->direct = true;
+        this->staging.resize(static_cast<size_t>(2 * staging_size + avi::direct_io_alignment));
+        const size_t misalignment = reinterpret_cast<std::uintptr_t>(this->staging.data()) % avi::direct_io_alignment;
+        this->staging_buffers[0] = this->staging.data() + ((avi::direct_io_alignment - misalignment) % avi::direct_io_alignment);
+        this->staging_buffers[1] = this->staging_buffers[0] + staging_size;
+        this->staging_index = 0;
+        this->staging_offset = 0;
+        this->staging_length = 0;
+        this->stopping = false;
+        this->pending_length = 0;
+        this->pending_failed = false;
+        this->direct_rejected = false;
+        this->thread = std::thread(&avi_writer::write_behind, this);
+        return true;
+    }
+
+    // Write out the last staged data and stop the I/O thread, the file is padded to the alignment for the last write and then truncated.
+    bool end_direct(bool flush) {
+        bool success = true;
+        if (flush) {
+            const unsigned long long int padded_length = (this->staging_length + avi::direct_io_alignment - 1) / avi::direct_io_alignment * avi::direct_io_alignment;
+            std::memset(this->staging_buffers[this->staging_index] + this->staging_length, 0, static_cast<size_t>(padded_length - this->staging_length));
+            success = ((padded_length == 0) || (this->submit_staging(padded_length))) && (this->wait_staging());
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->condition.notify_all();
+        this->thread.join();
+
+#if defined(_WIN32)
+        CloseHandle(this->direct_file);
+        this->direct_file = INVALID_HANDLE_VALUE;
+        if (success) {
+            FILE_END_OF_FILE_INFO end_of_file = {};
+            end_of_file.EndOfFile.QuadPart = static_cast<LONGLONG>(this->offset);
+            success = (SetFileInformationByHandle(this->file, FileEndOfFileInfo, &end_of_file, sizeof(end_of_file)) != 0);
+        }
+#else
+        ::close(this->direct_file);
+        this->direct_file = -1;
+        if (success) {
+            success = (ftruncate(this->file, static_cast<off_t>(this->offset)) == 0);
+        }
+#endif
+        if (!success) {
+            std::fprintf(stderr, "Error: Failed to write to avi file.\n");
+        }
+        success = success && this->sync();
+
+        this->direct = false;
+        this->staging.clear();
+        this->staging.shrink_to_fit();
+        return success;
+    }
+
+    // Copy appended data into the staging buffer, handing each full buffer to the I/O thread.
+    bool stage(const void* data, unsigned long long int length) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        while (length > 0) {
+            const unsigned long long int space = staging_size - this->staging_length;
+            const unsigned long long int request = (length < space) ? length : space;
+            std::memcpy(this->staging_buffers[this->staging_index] + this->staging_length, bytes, static_cast<size_t>(request));
+            this->staging_length += request;
+            bytes += request;
+            length -= request;
+            if ((this->staging_length == staging_size) && (!this->submit_staging(staging_size))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Hand the first length bytes of the buffer being filled to the I/O thread, once it has finished with the other, and start filling the other.
+    // Any staged data after them is carried over to the start of the other buffer.
+    bool submit_staging(unsigned long long int length) {
+        if (!this->wait_staging()) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->pending_data = this->staging_buffers[this->staging_index];
+            this->pending_offset = this->staging_offset;
+            this->pending_length = length;
+        }
+        this->condition.notify_all();
+        const unsigned char* submitted = this->staging_buffers[this->staging_index];
+        const unsigned long long int carried = (length < this->staging_length) ? (this->staging_length - length) : 0;
+        this->staging_index ^= 1;
+        std::memcpy(this->staging_buffers[this->staging_index], submitted + length, static_cast<size_t>(carried));
+        this->staging_offset += this->staging_length - carried;
+        this->staging_length = carried;
+        return true;
+    }
+
+    // Write out everything staged without waiting for the buffer to fill.
+    // The partial block at the end is written padded with zeros, and written again in full once its buffer is submitted.
+    bool flush_staging() {
+        const unsigned long long int aligned_length = this->staging_length / avi::direct_io_alignment * avi::direct_io_alignment;
+        if (((aligned_length > 0) && (!this->submit_staging(aligned_length))) || (!this->wait_staging())) {
+            return false;
+        }
+        if (this->staging_length == 0) {
+            return true;
+        }
+        unsigned char* block = this->staging_buffers[this->staging_index];
+        std::memset(block + this->staging_length, 0, static_cast<size_t>(avi::direct_io_alignment - this->staging_length));
+        const bool written = (!this->direct_rejected) ? write_file(this->direct_file, this->staging_offset, block, avi::direct_io_alignment) : write_file(this->file, this->staging_offset, block, avi::direct_io_alignment);
+        if (!written) {
+            std::fprintf(stderr, "Error: Failed to write to avi file.\n");
+            return false;
+        }
+        return true;
+    }
+
+    // Wait for the I/O thread to finish writing, returns false if anything it wrote failed.
+    bool wait_staging() {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->condition.wait(lock, [&]() {
+            return (this->pending_length == 0);
+        });
+        if (this->pending_failed) {
+            std::fprintf(stderr, "Error: Failed to write to avi file.\n");
+            return false;
+        }
+        return true;
+    }
+
+    void write_behind() {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while (true) {
+            this->condition.wait(lock, [&]() {
+                return (this->stopping) || (this->pending_length > 0);
+            });
+            if (this->pending_length == 0) {
+                return;
+            }
+            const unsigned char* data = this->pending_data;
+            const unsigned long long int position = this->pending_offset;
+            const unsigned long long int length = this->pending_length;
+            lock.unlock();
+
+            bool written = (!this->direct_rejected) && (write_file(this->direct_file, position, data, length));
+            if ((!written) && (!this->direct_rejected)) {
+                std::fprintf(stderr, "Warning: Direct I/O was rejected writing avi file, writing through the page cache.\n");
+                this->direct_rejected = true;
+            }
+            if (!written) {
+                written = write_file(this->file, position, data, length);
+            }
+            written = (written) && (this->count_unsynced(length));
+
+            lock.lock();
+            this->pending_length = 0;
+            this->pending_failed = (this->pending_failed) || (!written);
+            this->condition.notify_all();
+        }
+    }
+
+    static bool write_file(file_type destination, unsigned long long int position, const void* data, unsigned long long int length) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        while (length > 0) {
+#if defined(_WIN32)
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = static_cast<DWORD>(position);
+            overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+            DWORD written = 0;
+            const DWORD request = static_cast<DWORD>((length < 0x40000000) ? length : 0x40000000);
+            if ((!WriteFile(destination, bytes, request, &written, &overlapped)) || (written == 0)) {
+                return false;
+            }
+#else
+            const size_t request = static_cast<size_t>((length < 0x40000000) ? length : 0x40000000);
+            const ssize_t written = pwrite(destination, bytes, request, static_cast<off_t>(position));
+            if (written <= 0) {
+                return false;
+            }
+#endif
+            bytes += written;
+            position += static_cast<unsigned long long int>(written);
+            length -= static_cast<unsigned long long int>(written);
+        }
+        return true;
+    }
+
+    // Append data from another file, using copy_file_range on Linux and falling back to reading through a buffer.
+    // With direct I/O the data is always read through the buffer, to be staged.
+    bool copy_from(file_type source, unsigned long long int source_offset, unsigned long long int length) {
+#if defined(__linux__) && defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 27)))
+        while ((!this->direct) && (length > 0)) {
+            loff_t source_position = static_cast<loff_t>(source_offset);
+            loff_t position = static_cast<loff_t>(this->offset);
+            const size_t request = static_cast<size_t>((length < 0x40000000) ? length : 0x40000000);
+            const ssize_t copied = copy_file_range(source, &source_position, this->file, &position, request, 0);
+            if (copied <= 0) {
+                // Not supported between these files, copy the rest through the buffer.
+                break;
+            }
+            source_offset += static_cast<unsigned long long int>(copied);
+            this->offset += static_cast<unsigned long long int>(copied);
+            length -= static_cast<unsigned long long int>(copied);
+            if (!this->count_unsynced(static_cast<unsigned long long int>(copied))) {
+                return false;
+            }
+        }
+#endif
+        if (length > 0) {
+            this->copy_buffer.resize(0x00100000);
+        }
+        while (length > 0) {
+            const unsigned long long int request = (length < this->copy_buffer.size()) ? length : this->copy_buffer.size();
+            if (avi::read_at(source, source_offset, this->copy_buffer.data(), request) != request) {
+                std::fprintf(stderr, "Error: Failed to read frame to copy into avi file.\n");
+                return false;
+            }
+            if (!this->write(this->copy_buffer.data(), request)) {
+                return false;
+            }
+            source_offset += request;
+            length -= request;
+        }
+        return true;
+    }
+};
@@ -20,6 +20,35 @@ public:
         median
     };
 
+    // What generated tables are optimised for:
+    // - size: The smallest encoded frames.
+    // - decode_speed: Codes short enough that every symbol decodes with a single first level lookup.
+    enum class optimisation_type {
+        size,
+        decode_speed
+    };
+
+public:
+    // Counts of each residual value for the Y,U,V or B,G,R or B-G,G,R-G (decorrelation) tables, accumulated by analyse.
+    // Note: As with the tables, Y counts include both Y samples and R or R-G counts include the A channel of RGBA data.
+    class histogram_type final {
+    public:
+        unsigned long long int counts[3][256];
+    };
+
+    // An encoder configuration chosen by select_configuration.
+    // The packed table data can be passed directly to the constructor along with the predictor and decorrelation settings.
+    class configuration_type final {
+    public:
+        predictor_type predictor;
+        bool decorrelated;
+        // Estimated total size in bytes of the analysed frames when encoded with this configuration.
+        unsigned long long int estimated_length;
+        // Every run of the runlength packed tables takes at most two bytes, followed by a null byte.
+        unsigned char table_data[3 * 256 * 2 + 1];
+        unsigned int table_length;
+    };
+
 private:
     // Static Y,U,V or B,G,R or B-G,G,R-G (decorrelation) huffman tables for the different prediction modes.
     // Note: When processing RGBA data, A is processed with either the R table or the R-G table (decorrelation).
@@ -746,9 +775,16 @@ private:
 
 private:
     class table_type final {
+    public:
+        // Number of leading stream bits resolved by the first level lookup.
+        constexpr static const int lookup_bits = 11;
+
     public:
         unsigned char shift[256];
         unsigned int add_shifted[256];
+        // Code length and symbol, as (length << 8) | symbol, for codes of at most lookup_bits indexed by the next lookup_bits of the stream.
+        // Zero where the code is longer, these are decoded using the pointers and data tables.
+        unsigned short lookup[1 << lookup_bits];
         unsigned char* pointers[32];
         unsigned char data[129 * 25];
     };
@@ -1187,86 +1223,216 @@ private:
 
             // Calculate the add shifted tables.
             for (int channel_index = 0; channel_index < 3; ++channel_index) {
-                int min_bits_processed = 32;
-                unsigned int bits = 0;
-                do {
-                    int max_bits_pending = 0;
-                    for (int i = 0; i < 256; ++i) {
-                        if ((this->tables[channel_index].shift[i] < min_bits_processed) && (this->tables[channel_index].shift[i] > max_bits_pending)) {
-                            max_bits_pending = this->tables[channel_index].shift[i];
-                        }
-                    }
-                    const unsigned int bit = 1 << (32 - max_bits_pending);
-                    if (bits & (bit - 1)) {
-                        std::fprintf(stderr, "Error: Invalid table in stream header.\n");
-                        return false;
-                    }
-                    for (int i = 0; i < 256; ++i) {
-                        if (this->tables[channel_index].shift[i] == max_bits_pending) {
-                            this->tables[channel_index].add_shifted[i] = bits;
-                            bits += bit;
-                        }
-                    }
-                    min_bits_processed = max_bits_pending;
-                } while (bits & 0xFFFFFFFF);
+                if (!calculate_add_shifted(this->tables[channel_index])) {
+                    std::fprintf(stderr, "Error: Invalid table in stream header.\n");
+                    return false;
+                }
             }
         }
 
         // Compute the huffyuv tables from the table data.
         for (int channel_index = 0; channel_index < 3; ++channel_index) {
-            int code_lengths[256] = {};
-            int code_firstbits[256] = {};
-            int table_lengths[32];
-            for (int i = 0; i < 32; ++i) {
-                table_lengths[i] = -1;
+            if (!calculate_lookup_tables(this->tables[channel_index])) {
+                std::fprintf(stderr, "Error: Invalid table, failed to compute lookup tables.\n");
+                return false;
             }
-            int all_zero_code = -1;
+        }
+
+        return true;
+    }
+
+    static bool calculate_add_shifted(
+        table_type& table
+    ) {
+        // Codes are assigned canonically, longest codes first, each left aligned in 32 bits.
+        int min_bits_processed = 32;
+        unsigned int bits = 0;
+        do {
+            int max_bits_pending = 0;
             for (int i = 0; i < 256; ++i) {
-                if (this->tables[channel_index].add_shifted[i] != 0) {
-                    for (int firstbit = 31; firstbit >= 0; --firstbit) {
-                        if (this->tables[channel_index].add_shifted[i] & (1 << firstbit)) {
-                            code_firstbits[i] = firstbit;
-                            const int code_length = this->tables[channel_index].shift[i] - (32 - firstbit);
-                            code_lengths[i] = code_length;
-                            table_lengths[firstbit] = static_cast<int>(table_lengths[firstbit]) > code_length ? static_cast<int>(table_lengths[firstbit]) : code_length;
-                            break;
-                        }
-                    }
-                } else {
-                    all_zero_code = i;
+                if ((table.shift[i] < min_bits_processed) && (table.shift[i] > max_bits_pending)) {
+                    max_bits_pending = table.shift[i];
                 }
             }
-            if (all_zero_code < 0) {
-                std::fprintf(stderr, "Error: Failed to find all zero code in table.\n");
+            // The code lengths do not fill the code space.
+            if (max_bits_pending == 0) {
                 return false;
             }
-            unsigned char* p = this->tables[channel_index].data;
-            *p++ = 31;
-            *p++ = static_cast<unsigned char>(all_zero_code);
-            for (int i = 0; i < 32; ++i) {
-                if (table_lengths[i] == -1) {
-                    this->tables[channel_index].pointers[i] = this->tables[channel_index].data;
-                } else {
-                    this->tables[channel_index].pointers[i] = p;
-                    *p++ = static_cast<unsigned char>(i - table_lengths[i]);
-                    p += 1 << table_lengths[i];
-                }
+            const unsigned int bit = 1 << (32 - max_bits_pending);
+            if (bits & (bit - 1)) {
+                return false;
             }
             for (int i = 0; i < 256; ++i) {
-                if (this->tables[channel_index].add_shifted[i]) {
-                    int firstbit = code_firstbits[i];
-                    int val = static_cast<int>(this->tables[channel_index].add_shifted[i]) - (1 << firstbit);
-                    unsigned char* table = this->tables[channel_index].pointers[firstbit];
-                    for (int j = 0; j < (1 << (table_lengths[firstbit] - code_lengths[i])); ++j) {
-                        (&table[1 + (val >> table[0])])[j] = static_cast<unsigned char>(i);
+                if (table.shift[i] == max_bits_pending) {
+                    table.add_shifted[i] = bits;
+                    bits += bit;
+                }
+            }
+            min_bits_processed = max_bits_pending;
+        } while (bits & 0xFFFFFFFF);
+        return true;
+    }
+
+    static bool calculate_lookup_tables(
+        table_type& table
+    ) {
+        int code_lengths[256] = {};
+        int code_firstbits[256] = {};
+        int table_lengths[32];
+        for (int i = 0; i < 32; ++i) {
+            table_lengths[i] = -1;
+        }
+        int all_zero_code = -1;
+        for (int i = 0; i < 256; ++i) {
+            if (table.add_shifted[i] != 0) {
+                for (int firstbit = 31; firstbit >= 0; --firstbit) {
+                    if (table.add_shifted[i] & (1u << firstbit)) {
+                        code_firstbits[i] = firstbit;
+                        const int code_length = table.shift[i] - (32 - firstbit);
+                        code_lengths[i] = code_length;
+                        table_lengths[firstbit] = static_cast<int>(table_lengths[firstbit]) > code_length ? static_cast<int>(table_lengths[firstbit]) : code_length;
+                        break;
                     }
                 }
+            } else {
+                all_zero_code = i;
+            }
+        }
+        if (all_zero_code < 0) {
+            return false;
+        }
+        // Each first bit has a lookup table indexed by the remaining bits of its longest code, all of them must fit.
+        unsigned long long int data_size = 2;
+        for (int i = 0; i < 32; ++i) {
+            if (table_lengths[i] != -1) {
+                data_size += 1 + (1ull << table_lengths[i]);
+            }
+        }
+        if (data_size > sizeof(table.data)) {
+            return false;
+        }
+        for (int i = 0; i < (1 << table_type::lookup_bits); ++i) {
+            table.lookup[i] = 0;
+        }
+        for (int i = 0; i < 256; ++i) {
+            if ((table.shift[i] > 0) && (table.shift[i] <= table_type::lookup_bits)) {
+                const unsigned int first = table.add_shifted[i] >> (32 - table_type::lookup_bits);
+                const unsigned int count = 1u << (table_type::lookup_bits - table.shift[i]);
+                for (unsigned int j = 0; j < count; ++j) {
+                    table.lookup[first + j] = static_cast<unsigned short>((table.shift[i] << 8) | i);
+                }
+            }
+        }
+        unsigned char* p = table.data;
+        *p++ = 31;
+        *p++ = static_cast<unsigned char>(all_zero_code);
+        for (int i = 0; i < 32; ++i) {
+            if (table_lengths[i] == -1) {
+                table.pointers[i] = table.data;
+            } else {
+                table.pointers[i] = p;
+                *p++ = static_cast<unsigned char>(i - table_lengths[i]);
+                p += 1 << table_lengths[i];
+            }
+        }
+        for (int i = 0; i < 256; ++i) {
+            if (table.add_shifted[i]) {
+                int firstbit = code_firstbits[i];
+                int val = static_cast<int>(table.add_shifted[i]) - (1 << firstbit);
+                unsigned char* lookup = table.pointers[firstbit];
+                for (int j = 0; j < (1 << (table_lengths[firstbit] - code_lengths[i])); ++j) {
+                    (&lookup[1 + (val >> lookup[0])])[j] = static_cast<unsigned char>(i);
+                }
             }
         }
-
         return true;
     }
 
+    static bool calculate_code_lengths(
+        const unsigned long long int* counts,
+        unsigned char* lengths,
+        int maximum_length
+    ) {
+        // Every one of the 256 symbols needs a code, and the stream header can only describe lengths up to 31 bits.
+        if ((maximum_length < 8) || (maximum_length > 31)) {
+            return false;
+        }
+
+        // Sort the symbols by count, unused symbols are treated as if they occurred once so they still get a code.
+        int symbols[256];
+        unsigned long long int weights[256];
+        for (int i = 0; i < 256; ++i) {
+            const unsigned long long int weight = (counts[i] == 0) ? 1 : counts[i];
+            int j = i;
+            for (; (j > 0) && (weights[j - 1] > weight); --j) {
+                symbols[j] = symbols[j - 1];
+                weights[j] = weights[j - 1];
+            }
+            symbols[j] = i;
+            weights[j] = weight;
+        }
+
+        // Package-merge, each list holds the cheapest leaves and packages (pairs from the next deeper list) for one level.
+        // Only the first 2n-2 items of any list can ever be selected so the lists are capped at that size.
+        constexpr static const int list_capacity = 2 * 256 - 2;
+        unsigned char packaged[31][list_capacity];
+        int list_lengths[31];
+        unsigned long long int list_weights[2][list_capacity];
+
+        // The deepest list only contains leaves.
+        for (int i = 0; i < 256; ++i) {
+            list_weights[(maximum_length - 1) % 2][i] = weights[i];
+            packaged[maximum_length - 1][i] = 0;
+        }
+        list_lengths[maximum_length - 1] = 256;
+
+        for (int level = maximum_length - 2; level >= 0; --level) {
+            const unsigned long long int* previous = list_weights[(level + 1) % 2];
+            unsigned long long int* current = list_weights[level % 2];
+            const int packages = list_lengths[level + 1] / 2;
+            int leaf = 0;
+            int package = 0;
+            int index = 0;
+            while ((index < list_capacity) && ((leaf < 256) || (package < packages))) {
+                const unsigned long long int package_weight = (package < packages) ? (previous[2 * package] + previous[2 * package + 1]) : 0;
+                if ((package >= packages) || ((leaf < 256) && (weights[leaf] <= package_weight))) {
+                    current[index] = weights[leaf++];
+                    packaged[level][index++] = 0;
+                }
+                else {
+                    current[index] = package_weight;
+                    packaged[level][index++] = 1;
+                    ++package;
+                }
+            }
+            list_lengths[level] = index;
+        }
+
+        // Select the 2n-2 cheapest items of the shallowest list, each selected leaf adds a bit to its symbol's code length.
+        // The selected packages are always a prefix of the packages, so they select a prefix of the next deeper list.
+        for (int i = 0; i < 256; ++i) {
+            lengths[i] = 0;
+        }
+        int selected = list_capacity;
+        for (int level = 0; (level < maximum_length) && (selected > 0); ++level) {
+            if (selected > list_lengths[level]) {
+                return false;
+            }
+            int leaves = 0;
+            int packages = 0;
+            for (int index = 0; index < selected; ++index) {
+                if (packaged[level][index]) {
+                    ++packages;
+                }
+                else {
+                    ++lengths[symbols[leaves++]];
+                }
+            }
+            selected = 2 * packages;
+        }
+        return (selected == 0);
+    }
+
 public:
     bool generate_stream_header(
         unsigned char* stream_header_data,
@@ -1386,38 +1552,43 @@ public:
             copy_bytes(&unused, &stream_header_data[43], 1);
         }
 
+        this->pack_tables(&stream_header_data[packed_table_index]);
+
+        return true;
+    }
+
+private:
+    void pack_tables(
+        unsigned char* packed_table_data
+    ) const {
         // Runlength compress table data of bit lengths per code.
         // Stored in these orders:
         //  - YUV: Y table, U table, V table
         //  - RGB (correlated): B table, G table, R table
         //  - RGB (decorrelated): B-G table, G table, R-G table
         // Note: For RGBA data the R or R-G table is used for the alpha channel.
-        {
-            unsigned int data_index = packed_table_index;
-            for (int channel_index = 0; channel_index < 3; ++channel_index) {
-                for (int table_index = 0; table_index < 256;) {
-                    const unsigned char value = this->tables[channel_index].shift[table_index];
-                    const int start_index = table_index;
-                    for (++table_index; table_index < 256 - 1; ++table_index) {
-                        if (value != this->tables[channel_index].shift[table_index]) {
-                            break;
-                        }
-                    }
-                    const unsigned char repetitions = table_index - start_index;
-                    if (repetitions < 8) {
-                        stream_header_data[data_index++] = (repetitions << 5) | (value & 0x1F);
-                    }
-                    else {
-                        stream_header_data[data_index++] = (value & 0x1F);
-                        stream_header_data[data_index++] = repetitions;
+        unsigned int data_index = 0;
+        for (int channel_index = 0; channel_index < 3; ++channel_index) {
+            for (int table_index = 0; table_index < 256;) {
+                const unsigned char value = this->tables[channel_index].shift[table_index];
+                const int start_index = table_index;
+                for (++table_index; table_index < 256 - 1; ++table_index) {
+                    if (value != this->tables[channel_index].shift[table_index]) {
+                        break;
                     }
                 }
+                const unsigned char repetitions = table_index - start_index;
+                if (repetitions < 8) {
+                    packed_table_data[data_index++] = (repetitions << 5) | (value & 0x1F);
+                }
+                else {
+                    packed_table_data[data_index++] = (value & 0x1F);
+                    packed_table_data[data_index++] = repetitions;
+                }
             }
-            // Should be at least one null byte at the end.
-            stream_header_data[data_index++] = 0;
         }
-
-        return true;
+        // Should be at least one null byte at the end.
+        packed_table_data[data_index++] = 0;
     }
 
 public:
@@ -1486,6 +1657,11 @@ public:
         return this->height * this->width * channel_bytes;
     }
 
+    // Frames that do not compress are stored uncompressed, so an encoded frame is never larger than a decoded one.
+    unsigned long long int get_max_encoded_size() const {
+        return this->get_decoded_image_size();
+    }
+
     unsigned int get_packed_table_size() const {
         if (!this->is_valid()) {
             return 0;
@@ -1510,28 +1686,200 @@ public:
     }
 
 public:
-    bool encode(
+    bool analyse(
         const unsigned char* decoded_data,
         unsigned long long int decoded_length,
-        unsigned char* encoded_data,
-        unsigned long long int& encoded_length
+        histogram_type& histogram
     ) const {
         if (!this->is_valid()) {
             return false;
         }
-        if ((encoded_data == nullptr) || (encoded_length < this->get_decoded_image_size()) || (decoded_data == nullptr) || (decoded_length < this->get_decoded_image_size())) {
+        if ((decoded_data == nullptr) || (decoded_length < this->get_decoded_image_size())) {
             return false;
         }
 
-        // Initially copy the decoded image so it can be processed in place.
+        // Apply the same prediction as encoding so the residuals are counted.
         unsigned char* buffer_data = new unsigned char[this->get_decoded_image_size()];
         copy_bytes(decoded_data, buffer_data, this->get_decoded_image_size());
+        if (!this->predict_frame(buffer_data)) {
+            delete[] buffer_data;
+            return false;
+        }
+
+        this->count_residuals(buffer_data, histogram);
+
+        delete[] buffer_data;
+        return true;
+    }
+
+    bool optimise_tables(
+        const histogram_type& histogram,
+        optimisation_type optimisation = optimisation_type::size
+    ) {
+        if (!this->is_valid()) {
+            return false;
+        }
+        if (this->predictor == predictor_type::classic) {
+            std::fprintf(stderr, "Error: Invalid settings, the classic predictor must use the builtin tables.\n");
+            return false;
+        }
+
+        // Find the code lengths for all tables before replacing any of them.
+        unsigned char lengths[3][256];
+        for (int channel_index = 0; channel_index < 3; ++channel_index) {
+            // Limit the code lengths further until the decoding lookup tables fit.
+            // When optimising for decode speed every code must be resolved by the first level lookup.
+            bool found = false;
+            const int longest_length = (optimisation == optimisation_type::decode_speed) ? table_type::lookup_bits : 31;
+            for (int maximum_length = longest_length; (maximum_length >= 8) && (!found); --maximum_length) {
+                if (!calculate_code_lengths(histogram.counts[channel_index], lengths[channel_index], maximum_length)) {
+                    continue;
+                }
+                table_type table;
+                copy_bytes(lengths[channel_index], table.shift, 256 * sizeof(unsigned char));
+                found = calculate_add_shifted(table) && calculate_lookup_tables(table);
+            }
+            if (!found) {
+                std::fprintf(stderr, "Error: Failed to generate table.\n");
+                return false;
+            }
+        }
+
+        for (int channel_index = 0; channel_index < 3; ++channel_index) {
+            copy_bytes(lengths[channel_index], this->tables[channel_index].shift, 256 * sizeof(unsigned char));
+            if ((!calculate_add_shifted(this->tables[channel_index])) || (!calculate_lookup_tables(this->tables[channel_index]))) {
+                std::fprintf(stderr, "Error: Failed to prepare generated table.\n");
+                this->valid = false;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Choose the predictor, decorrelation and tables giving the smallest output for a handful of sample frames.
+    // Every legal combination for the format is tried with tables generated from its residuals, and the resulting sizes are compared.
+    static bool select_configuration(
+        int width,
+        int height,
+        bool interlaced,
+        format_type format,
+        const unsigned char* const* frames,
+        unsigned int frame_count,
+        configuration_type& configuration,
+        optimisation_type optimisation = optimisation_type::size
+    ) {
+        if ((frames == nullptr) || (frame_count == 0)) {
+            return false;
+        }
+
+        // The classic predictor is not tried as it cannot store tables, it is the left predictor with different builtin tables.
+        constexpr static const int candidate_count = 3;
+        const predictor_type yuyv_predictors[candidate_count] = { predictor_type::left, predictor_type::gradient, predictor_type::median };
+        const bool yuyv_decorrelations[candidate_count] = { false, false, false };
+        const predictor_type bgr_predictors[candidate_count] = { predictor_type::left, predictor_type::left, predictor_type::gradient };
+        const bool bgr_decorrelations[candidate_count] = { false, true, true };
+        const predictor_type* predictors = (format == format_type::yuyv) ? yuyv_predictors : bgr_predictors;
+        const bool* decorrelations = (format == format_type::yuyv) ? yuyv_decorrelations : bgr_decorrelations;
+
+        bool found = false;
+        for (int candidate_index = 0; candidate_index < candidate_count; ++candidate_index) {
+            // Codecs hold pointers into their own tables so they cannot be copied, allocate each candidate in place.
+            huffyuv* candidate = new huffyuv(width, height, interlaced, decorrelations[candidate_index], format, predictors[candidate_index]);
+            if (!candidate->is_valid()) {
+                delete candidate;
+                return false;
+            }
+
+            histogram_type histogram = {};
+            for (unsigned int frame_index = 0; frame_index < frame_count; ++frame_index) {
+                if (!candidate->analyse(frames[frame_index], candidate->get_decoded_image_size(), histogram)) {
+                    delete candidate;
+                    return false;
+                }
+            }
+            if (!candidate->optimise_tables(histogram, optimisation)) {
+                delete candidate;
+                return false;
+            }
+
+            // Each frame is the uncompressed first pixel followed by the codes, padded to a multiple of 32 bits.
+            unsigned long long int bits = 0;
+            for (int channel_index = 0; channel_index < 3; ++channel_index) {
+                for (int value = 0; value < 256; ++value) {
+                    bits += histogram.counts[channel_index][value] * candidate->tables[channel_index].shift[value];
+                }
+            }
+            const unsigned long long int estimated_length = ((bits + 31) / 32 + frame_count) * 4;
+
+            if ((!found) || (estimated_length < configuration.estimated_length)) {
+                configuration.predictor = predictors[candidate_index];
+                configuration.decorrelated = decorrelations[candidate_index];
+                configuration.estimated_length = estimated_length;
+                configuration.table_length = candidate->get_packed_table_size();
+                candidate->pack_tables(configuration.table_data);
+                found = true;
+            }
+
+            delete candidate;
+        }
+
+        return found;
+    }
+
+public:
+    // When a histogram is given the residuals of the frame are also added to it, see analyse.
+    // Fails when the frame would not be smaller compressed, so every frame encoded is a standard HFYU frame.
+    bool encode(
+        const unsigned char* decoded_data,
+        unsigned long long int decoded_length,
+        unsigned char* encoded_data,
+        unsigned long long int& encoded_length,
+        histogram_type* histogram = nullptr
+    ) const {
+        return this->encode_frame(decoded_data, decoded_length, encoded_data, encoded_length, nullptr, histogram);
+    }
+
+    // As above, but a frame that would not be smaller compressed is copied uncompressed and stored is set instead of failing.
+    // A stored frame is not a HFYU frame and no HuffYUV decoder can decode it, it must be written as an uncompressed '##db' chunk.
+    // Stored BGR and BGRA frames are flipped to bottom-up rows, as other readers expect of an uncompressed RGB frame.
+    bool encode(
+        const unsigned char* decoded_data,
+        unsigned long long int decoded_length,
+        unsigned char* encoded_data,
+        unsigned long long int& encoded_length,
+        bool& stored,
+        histogram_type* histogram = nullptr
+    ) const {
+        return this->encode_frame(decoded_data, decoded_length, encoded_data, encoded_length, &stored, histogram);
+    }
+
+    // Frames stored uncompressed by encode must be told apart by their '##db' chunk type, they are not passed to decode.
+    bool decode(
+        const unsigned char* encoded_data,
+        unsigned long long int encoded_length,
+        unsigned char* decoded_data,
+        unsigned long long int& decoded_length
+    ) const {
+        if (!this->is_valid()) {
+            return false;
+        }
+        if ((encoded_data == nullptr) || (encoded_length == 0) || (decoded_data == nullptr) || (decoded_length < this->get_decoded_image_size())) {
+            return false;
+        }
 
         switch (this->format) {
             case format_type::yuyv: {
+                // Data is in Y U Y V order.
+                const table_type* channel_tables[4] = {
+                    &this->tables[0], &this->tables[1], &this->tables[0], &this->tables[2]
+                };
+                if (!decode_hfyu(encoded_data, encoded_length, decoded_data, &channel_tables[0])) {
+                    return false;
+                }
                 // Predictor values start from the second Y.
                 unsigned char predictor_values[3] = {
-                    buffer_data[2], buffer_data[1], buffer_data[3]
+                    decoded_data[2], decoded_data[1], decoded_data[3]
                 };
                 // Predictors are in Y U Y V order.
                 unsigned char* predictors[4] = {
@@ -1540,32 +1888,37 @@ public:
                 switch (this->predictor) {
                     case predictor_type::classic:
                     case predictor_type::left: {
-                        predict_left(buffer_data, &predictors[0]);
+                        unpredict_left(decoded_data, &predictors[0]);
                     } break;
                     case predictor_type::gradient: {
-                        predict_gradient(buffer_data);
-                        predict_left(buffer_data, &predictors[0]);
+                        unpredict_left(decoded_data, &predictors[0]);
+                        unpredict_gradient(decoded_data);
                     } break;
                     case predictor_type::median: {
-                        predict_median(buffer_data, &predictors[0]);
+                        unpredict_median(decoded_data, &predictors[0]);
                     } break;
                 }
-                // Data is in Y U Y V order.
-                const table_type* channel_tables[4] = {
-                    &this->tables[0], &this->tables[1], &this->tables[0], &this->tables[2]
-                };
-                if (!encode_hfyu(buffer_data, encoded_data, encoded_length, &channel_tables[0])) {
-                    delete[] buffer_data;
-                    return false;
-                }
+                decoded_length = this->get_decoded_image_size();
             } break;
 
             case format_type::bgr:
             case format_type::bgra: {
-                flip(buffer_data);
+                // Data is in B G R (A) order.
+                const table_type* channel_tables[4] = {
+                    &this->tables[0], &this->tables[1], &this->tables[2], &this->tables[2]
+                };
+                if (this->decorrelated) {
+                    // When decorrelated data is in G B-G R-G (A) order, except for the first pixel.
+                    const table_type* temp = channel_tables[0];
+                    channel_tables[0] = channel_tables[1];
+                    channel_tables[1] = temp;
+                }
+                if (!decode_hfyu(encoded_data, encoded_length, decoded_data, &channel_tables[0])) {
+                    return false;
+                }
                 // First pixel is in B G R (A) order.
                 unsigned char predictor_values[4] = {
-                    buffer_data[0], buffer_data[1], buffer_data[2], buffer_data[3]
+                    decoded_data[0], decoded_data[1], decoded_data[2], decoded_data[3]
                 };
                 if (this->decorrelated) {
                     // When decorrelated have to subtract G from the B and R channels.
@@ -1585,69 +1938,89 @@ public:
                 switch (this->predictor) {
                     case predictor_type::classic:
                     case predictor_type::left: {
+                        unpredict_left(decoded_data, &predictors[0]);
                         if (this->decorrelated) {
-                            decorrelate(buffer_data);
+                            recorrelate(decoded_data);
                         }
-                        predict_left(buffer_data, &predictors[0]);
                     } break;
                     case predictor_type::gradient: {
-                        predict_gradient(buffer_data);
+                        unpredict_left(decoded_data, &predictors[0]);
                         if (this->decorrelated) {
-                            decorrelate(buffer_data);
+                            recorrelate(decoded_data);
                         }
-                        predict_left(buffer_data, &predictors[0]);
+                        unpredict_gradient(decoded_data);
                     } break;
                     case predictor_type::median: {
-                        delete[] buffer_data;
                         return false;
                     } break;
                 }
-                // Data is in B G R (A) order.
-                const table_type* channel_tables[4] = {
-                    &this->tables[0], &this->tables[1], &this->tables[2], &this->tables[2]
-                };
-                if (this->decorrelated) {
-                    // When decorrelated data is in G B-G R-G (A) order, except for the first pixel.
-                    const table_type* temp = channel_tables[0];
-                    channel_tables[0] = channel_tables[1];
-                    channel_tables[1] = temp;
-                }
-                if (!encode_hfyu(buffer_data, encoded_data, encoded_length, &channel_tables[0])) {
-                    delete[] buffer_data;
-                    return false;
-                }
+                flip(decoded_data);
+                decoded_length = this->get_decoded_image_size();
             } break;
         }
 
-        delete[] buffer_data;
         return true;
     }
 
-    bool decode(
-        const unsigned char* encoded_data,
-        unsigned long long int encoded_length,
-        unsigned char* decoded_data,
-        unsigned long long int& decoded_length
+private:
+    bool encode_frame(
+        const unsigned char* decoded_data,
+        unsigned long long int decoded_length,
+        unsigned char* encoded_data,
+        unsigned long long int& encoded_length,
+        bool* stored,
+        histogram_type* histogram
     ) const {
         if (!this->is_valid()) {
             return false;
         }
-        if ((encoded_data == nullptr) || (encoded_length == 0) || (decoded_data == nullptr) || (decoded_length < this->get_decoded_image_size())) {
+        if ((encoded_data == nullptr) || (encoded_length < this->get_max_encoded_size()) || (decoded_data == nullptr) || (decoded_length < this->get_decoded_image_size())) {
+            return false;
+        }
+
+        // Initially copy the decoded image so it can be processed in place.
+        unsigned char* buffer_data = new unsigned char[this->get_decoded_image_size()];
+        copy_bytes(decoded_data, buffer_data, this->get_decoded_image_size());
+
+        if (!this->predict_frame(buffer_data)) {
+            delete[] buffer_data;
             return false;
         }
 
+        if (histogram != nullptr) {
+            this->count_residuals(buffer_data, *histogram);
+        }
+
+        const table_type* channel_tables[4];
+        this->get_channel_tables(&channel_tables[0]);
+        const bool compressed = encode_hfyu(buffer_data, encoded_data, encoded_length, &channel_tables[0]);
+        delete[] buffer_data;
+        if (stored != nullptr) {
+            *stored = !compressed;
+        }
+        if (!compressed) {
+            if (stored == nullptr) {
+                std::fprintf(stderr, "Error: Failed to encode frame, result would be larger than original.\n");
+                return false;
+            }
+            copy_bytes(decoded_data, encoded_data, this->get_decoded_image_size());
+            encoded_length = this->get_decoded_image_size();
+            if ((this->format == format_type::bgr) || (this->format == format_type::bgra)) {
+                // Uncompressed RGB frames are bottom-up DIBs, just as the compressed path flips before predicting.
+                flip(encoded_data);
+            }
+        }
+        return true;
+    }
+
+    bool predict_frame(
+        unsigned char* frame
+    ) const {
         switch (this->format) {
             case format_type::yuyv: {
-                // Data is in Y U Y V order.
-                const table_type* channel_tables[4] = {
-                    &this->tables[0], &this->tables[1], &this->tables[0], &this->tables[2]
-                };
-                if (!decode_hfyu(encoded_data, encoded_length, decoded_data, &channel_tables[0])) {
-                    return false;
-                }
                 // Predictor values start from the second Y.
                 unsigned char predictor_values[3] = {
-                    decoded_data[2], decoded_data[1], decoded_data[3]
+                    frame[2], frame[1], frame[3]
                 };
                 // Predictors are in Y U Y V order.
                 unsigned char* predictors[4] = {
@@ -1656,37 +2029,24 @@ public:
                 switch (this->predictor) {
                     case predictor_type::classic:
                     case predictor_type::left: {
-                        unpredict_left(decoded_data, &predictors[0]);
+                        predict_left(frame, &predictors[0]);
                     } break;
                     case predictor_type::gradient: {
-                        unpredict_left(decoded_data, &predictors[0]);
-                        unpredict_gradient(decoded_data);
+                        predict_gradient(frame);
+                        predict_left(frame, &predictors[0]);
                     } break;
                     case predictor_type::median: {
-                        unpredict_median(decoded_data, &predictors[0]);
+                        predict_median(frame, &predictors[0]);
                     } break;
                 }
-                decoded_length = this->get_decoded_image_size();
             } break;
 
             case format_type::bgr:
             case format_type::bgra: {
-                // Data is in B G R (A) order.
-                const table_type* channel_tables[4] = {
-                    &this->tables[0], &this->tables[1], &this->tables[2], &this->tables[2]
-                };
-                if (this->decorrelated) {
-                    // When decorrelated data is in G B-G R-G (A) order, except for the first pixel.
-                    const table_type* temp = channel_tables[0];
-                    channel_tables[0] = channel_tables[1];
-                    channel_tables[1] = temp;
-                }
-                if (!decode_hfyu(encoded_data, encoded_length, decoded_data, &channel_tables[0])) {
-                    return false;
-                }
+                flip(frame);
                 // First pixel is in B G R (A) order.
                 unsigned char predictor_values[4] = {
-                    decoded_data[0], decoded_data[1], decoded_data[2], decoded_data[3]
+                    frame[0], frame[1], frame[2], frame[3]
                 };
                 if (this->decorrelated) {
                     // When decorrelated have to subtract G from the B and R channels.
@@ -1706,31 +2066,159 @@ public:
                 switch (this->predictor) {
                     case predictor_type::classic:
                     case predictor_type::left: {
-                        unpredict_left(decoded_data, &predictors[0]);
                         if (this->decorrelated) {
-                            recorrelate(decoded_data);
+                            decorrelate(frame);
                         }
+                        predict_left(frame, &predictors[0]);
                     } break;
                     case predictor_type::gradient: {
-                        unpredict_left(decoded_data, &predictors[0]);
+                        predict_gradient(frame);
                         if (this->decorrelated) {
-                            recorrelate(decoded_data);
+                            decorrelate(frame);
                         }
-                        unpredict_gradient(decoded_data);
+                        predict_left(frame, &predictors[0]);
                     } break;
                     case predictor_type::median: {
                         return false;
                     } break;
                 }
-                flip(decoded_data);
-                decoded_length = this->get_decoded_image_size();
             } break;
         }
-
         return true;
     }
 
-private:
+    void get_channel_tables(
+        const table_type** channel_tables
+    ) const {
+        switch (this->format) {
+            case format_type::yuyv: {
+                // Data is in Y U Y V order.
+                channel_tables[0] = &this->tables[0];
+                channel_tables[1] = &this->tables[1];
+                channel_tables[2] = &this->tables[0];
+                channel_tables[3] = &this->tables[2];
+            } break;
+
+            case format_type::bgr:
+            case format_type::bgra: {
+                // Data is in B G R (A) order.
+                channel_tables[0] = &this->tables[0];
+                channel_tables[1] = &this->tables[1];
+                channel_tables[2] = &this->tables[2];
+                channel_tables[3] = &this->tables[2];
+                if (this->decorrelated) {
+                    // When decorrelated data is in G B-G R-G (A) order, except for the first pixel.
+                    const table_type* temp = channel_tables[0];
+                    channel_tables[0] = channel_tables[1];
+                    channel_tables[1] = temp;
+                }
+            } break;
+        }
+    }
+
+    void count_residuals(
+        const unsigned char* residuals,
+        histogram_type& histogram
+    ) const {
+        const table_type* channel_tables[4];
+        this->get_channel_tables(&channel_tables[0]);
+
+        const int channels = (this->format == format_type::bgr) ? 3 : 4;
+        const unsigned long long int pixels = this->get_decoded_image_size() / channels;
+
+        // Each channel of each pixel parity is counted into its own sub-histogram.
+        // Neighbouring bytes are often equal, this stops consecutive increments waiting on the store to the same counter.
+        // The sub-histograms are flushed into the histogram before their counters could overflow.
+        constexpr static const unsigned long long int flush_pixels = 1ull << 31;
+        unsigned int sub_counts[2][4][256];
+
+        // The very first pixel is stored uncompressed so is not counted.
+        unsigned long long int pixel = 1;
+        while (pixel < pixels) {
+            for (int parity = 0; parity < 2; ++parity) {
+                for (int channel = 0; channel < 4; ++channel) {
+                    for (int value = 0; value < 256; ++value) {
+                        sub_counts[parity][channel][value] = 0;
+                    }
+                }
+            }
+
+            const unsigned long long int pixel_end = ((pixels - pixel) > flush_pixels) ? (pixel + flush_pixels) : pixels;
+            const unsigned char* data = &residuals[pixel * channels];
+            if (channels == 4) {
+                for (; pixel + 1 < pixel_end; pixel += 2, data += 8) {
+                    ++sub_counts[0][0][data[0]];
+                    ++sub_counts[0][1][data[1]];
+                    ++sub_counts[0][2][data[2]];
+                    ++sub_counts[0][3][data[3]];
+                    ++sub_counts[1][0][data[4]];
+                    ++sub_counts[1][1][data[5]];
+                    ++sub_counts[1][2][data[6]];
+                    ++sub_counts[1][3][data[7]];
+                }
+            }
+            else {
+                for (; pixel + 1 < pixel_end; pixel += 2, data += 6) {
+                    ++sub_counts[0][0][data[0]];
+                    ++sub_counts[0][1][data[1]];
+                    ++sub_counts[0][2][data[2]];
+                    ++sub_counts[1][0][data[3]];
+                    ++sub_counts[1][1][data[4]];
+                    ++sub_counts[1][2][data[5]];
+                }
+            }
+            if (pixel < pixel_end) {
+                for (int channel = 0; channel < channels; ++channel) {
+                    ++sub_counts[0][channel][data[channel]];
+                }
+                ++pixel;
+            }
+
+            // Fold the channels into their tables, for yuyv both Y channels share a table and for bgra alpha uses the red table.
+            for (int channel = 0; channel < channels; ++channel) {
+                unsigned long long int* counts = histogram.counts[channel_tables[channel] - &this->tables[0]];
+                for (int value = 0; value < 256; ++value) {
+                    counts[value] += static_cast<unsigned long long int>(sub_counts[0][channel][value]) + sub_counts[1][channel][value];
+                }
+            }
+        }
+    }
+
+    static const unsigned char* find_non_zero_byte(
+        const unsigned char* data,
+        const unsigned char* data_end
+    ) {
+        // Test eight bytes at a time while they are all zero.
+        while (data_end - data >= 8) {
+            unsigned long long int block = 0;
+            copy_bytes(data, &block, 8);
+            if (block != 0) {
+                break;
+            }
+            data += 8;
+        }
+        while ((data < data_end) && (*data == 0)) {
+            ++data;
+        }
+        return data;
+    }
+
+    static const unsigned char* find_zero_block(
+        const unsigned char* data,
+        const unsigned char* data_end
+    ) {
+        // Test eight bytes at a time until they are all zero.
+        while (data_end - data >= 8) {
+            unsigned long long int block = 0;
+            copy_bytes(data, &block, 8);
+            if (block == 0) {
+                return data;
+            }
+            data += 8;
+        }
+        return data_end;
+    }
+
     bool encode_hfyu(
         const unsigned char* decompressed,
         unsigned char* compressed,
@@ -1740,52 +2228,88 @@ private:
         const int width = (this->format == format_type::yuyv) ? (this->width / 2) : this->width;
         const int height = this->height;
         const int channels = (this->format == format_type::yuyv) ? 4 : ((this->format == format_type::bgr) ? 3 : 4);
+        const unsigned int pixels = height * width;
+        const unsigned int stream_limit = pixels * channels * 8;
+        const unsigned char* const decompressed_end = decompressed + pixels * channels;
+
+        // A pixel of zero residuals always has the same codes, so runs of zero pixels are written a group at a time.
+        // The codes of a group of zero pixels are concatenated into one pattern of at most 31 bits, written like a single code.
+        unsigned int zero_pixel_shift = 0;
+        for (int channel = 0; channel < channels; ++channel) {
+            zero_pixel_shift += channel_tables[channel]->shift[0];
+        }
+        const unsigned int zero_group_pixels = ((zero_pixel_shift > 0) && (zero_pixel_shift < 32)) ? (31 / zero_pixel_shift) : 0;
+        const unsigned int zero_group_bytes = zero_group_pixels * channels;
+        const unsigned char zero_group_shift = static_cast<unsigned char>(zero_group_pixels * zero_pixel_shift);
+        unsigned int zero_group_add = 0;
+        for (unsigned int group_pixel = 0; group_pixel < zero_group_pixels; ++group_pixel) {
+            for (int channel = 0; channel < channels; ++channel) {
+                const unsigned char shift = channel_tables[channel]->shift[0];
+                if (shift > 0) {
+                    zero_group_add = (zero_group_add << shift) | (channel_tables[channel]->add_shifted[0] >> (32 - shift));
+                }
+            }
+        }
 
         unsigned int bit_stream = 0;
         unsigned int stream_index = 0;
         unsigned int shift_index = 0;
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                // Handle the very first pixel separately, it is stored uncompressed.
-                if ((y == 0) && (x == 0)) {
-                    // For rgb streams there is still fours bytes for the first pixel so the first byte is cleared.
-                    if (this->format == format_type::bgr) {
-                        *compressed++ = 0;
-                    }
-                    for (int channel = 0; channel < channels; ++channel) {
-                        *compressed++ = *decompressed++;
-                    }
-                    stream_index += 32;
-                    continue;
-                }
+        const auto write_code = [&](unsigned int add, unsigned char shift) {
+            shift_index += shift;
+            if (shift_index < 32) {
+                bit_stream = (bit_stream << shift) | add;
+                return;
+            }
+
+            shift_index -= 32;
+            const unsigned char shift_remainder = shift - shift_index;
+            bit_stream = (bit_stream << shift_remainder) | (add >> shift_index);
+            *compressed++ = (bit_stream >>  0) & 0xFF;
+            *compressed++ = (bit_stream >>  8) & 0xFF;
+            *compressed++ = (bit_stream >> 16) & 0xFF;
+            *compressed++ = (bit_stream >> 24) & 0xFF;
+            bit_stream = add;
+            stream_index += 32;
+        };
+
+        // Handle the very first pixel separately, it is stored uncompressed.
+        // For rgb streams there is still fours bytes for the first pixel so the first byte is cleared.
+        if (this->format == format_type::bgr) {
+            *compressed++ = 0;
+        }
+        for (int channel = 0; channel < channels; ++channel) {
+            *compressed++ = *decompressed++;
+        }
+        stream_index += 32;
 
+        // End of the zero bytes found by the last search for a run, the next search starts from here.
+        const unsigned char* zero_end = decompressed;
+        while (decompressed < decompressed_end) {
+            // Pixels before the next eight zero bytes are written a code at a time.
+            const unsigned char* zero_start = (zero_group_pixels > 0) ? find_zero_block(zero_end, decompressed_end) : decompressed_end;
+            while (decompressed < zero_start) {
                 for (int channel = 0; channel < channels; ++channel) {
-                    if ((stream_index + 32) >= static_cast<unsigned int>(height * width * channels * 8)) {
-                        fprintf(stderr, "Failed to encode frame, result would be larger than original.\n");
+                    if ((stream_index + 32) >= stream_limit) {
                         return false;
                     }
 
                     const unsigned char decoded = *decompressed++;
                     const unsigned char shift = channel_tables[channel]->shift[decoded];
                     const unsigned int add = channel_tables[channel]->add_shifted[decoded] >> (32 - shift);
-
-                    shift_index += shift;
-                    if (shift_index < 32) {
-                        bit_stream = (bit_stream << shift) | add;
-                        continue;
-                    }
-
-                    shift_index -= 32;
-                    const unsigned char shift_remainder = shift - shift_index;
-                    bit_stream = (bit_stream << shift_remainder) | (add >> shift_index);
-                    *compressed++ = (bit_stream >>  0) & 0xFF;
-                    *compressed++ = (bit_stream >>  8) & 0xFF;
-                    *compressed++ = (bit_stream >> 16) & 0xFF;
-                    *compressed++ = (bit_stream >> 24) & 0xFF;
-                    bit_stream = add;
-                    stream_index += 32;
+                    write_code(add, shift);
                 }
             }
+            if (decompressed >= decompressed_end) {
+                break;
+            }
+
+            // The pixel started inside the zero bytes, so write groups of zero pixels until the run ends.
+            // A group writes at most one word, so well below the limit the size check cannot fail part way through a group.
+            zero_end = find_non_zero_byte(decompressed, decompressed_end);
+            while ((decompressed + zero_group_bytes <= zero_end) && (stream_index + 64 < stream_limit)) {
+                write_code(zero_group_add, zero_group_shift);
+                decompressed += zero_group_bytes;
+            }
         }
         if (shift_index > 0) {
             bit_stream = bit_stream << (32 - shift_index);
@@ -1795,6 +2319,10 @@ private:
             *compressed++ = (bit_stream >> 24) & 0xFF;
             stream_index += 32;
         }
+        // A compressed frame no smaller than the original is no use, it is stored uncompressed instead.
+        if (stream_index >= stream_limit) {
+            return false;
+        }
         compressed_size = stream_index / 8;
         return true;
     }
@@ -1862,6 +2390,14 @@ private:
                     // Then extract the most significant four bytes as these will contain the code.
                     const unsigned int code = fine_data >> 32;
 
+                    // Short codes are resolved directly from the leading bits.
+                    const unsigned short lookup = channel_tables[channel]->lookup[code >> (32 - table_type::lookup_bits)];
+                    if (lookup != 0) {
+                        *decompressed++ = static_cast<unsigned char>(lookup & 0xFF);
+                        stream_index += lookup >> 8;
+                        continue;
+                    }
+
                     // Find the index of the most significant bit, ensure an index is found by bitwise ORing the least significant bit.
                     const int tree_index = find_most_significant_bit_index(code | 1);
 
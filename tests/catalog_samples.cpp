@@ -0,0 +1,133 @@
+#include <avi.hpp>
+#include <avi_catalog.hpp>
+#include <huffyuv.hpp>
+
+#include "samples.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    // A file cut short within its headers is catalogued as unreadable, it sorts before the samples.
+    const char* truncated_path = "catalog_samples_truncated.avi";
+    {
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(0, length);
+        std::FILE* truncated_file = std::fopen(truncated_path, "wb");
+        if ((file == nullptr) || (truncated_file == nullptr) || (std::fwrite(file.get(), 1, 100, truncated_file) != 100) || (std::fclose(truncated_file) != 0)) {
+            std::fprintf(stderr, "Failed to write truncated avi.\n");
+            return 1;
+        }
+    }
+
+    // Scanning with one thread and with many must give the same catalogue.
+    std::string reports[2];
+    for (int variant = 0; variant < 2; ++variant) {
+        avi_catalog catalog;
+        if (!catalog.scan({ "samples", truncated_path }, (variant == 0) ? 1 : 8)) {
+            std::fprintf(stderr, "Failed to scan catalog variant %d.\n", variant);
+            return 1;
+        }
+        const std::vector<avi_catalog::entry_type>& entries = catalog.get_entries();
+        if (entries.size() != sample_names.size() + 1) {
+            std::fprintf(stderr, "Failed to find every file with catalog variant %d.\n", variant);
+            return 1;
+        }
+
+        for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+            // Load avi.
+            size_t length = 0;
+            std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+            if ((file == nullptr) || (length == 0)) {
+                fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+
+            // Decode avi.
+            avi video;
+            if (!video.parse(file.get(), length)) {
+                std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+
+            // The entry must match the headers of the whole file and the codec configured from them.
+            const std::string path = "samples/" + sample_names[index_sample];
+            const avi_catalog::entry_type* entry = nullptr;
+            for (const avi_catalog::entry_type& candidate : entries) {
+                entry = (candidate.path == path) ? &candidate : entry;
+            }
+            if ((entry == nullptr) || (!entry->parsed)) {
+                std::fprintf(stderr, "Failed to catalog sample '%s' with variant %d.\n", sample_names[index_sample].c_str(), variant);
+                return 1;
+            }
+            size_t index_entry = 0;
+            for (size_t stream_number = 0; stream_number < video.get_streams(); ++stream_number) {
+                const avi::stream_type& stream = video.get_stream(stream_number);
+                if (stream.strf_vids == nullptr) {
+                    continue;
+                }
+                if (index_entry >= entry->streams.size()) {
+                    std::fprintf(stderr, "Failed to catalog stream %zu of sample '%s' with variant %d.\n", stream_number, sample_names[index_sample].c_str(), variant);
+                    return 1;
+                }
+                const avi_catalog::stream_entry_type& stream_entry = entry->streams[index_entry++];
+                huffyuv codec(reinterpret_cast<const unsigned char*>(stream.strf_vids), stream.strf_vids->header_size);
+                if (
+                    (stream_entry.stream != stream_number) ||
+                    (stream_entry.compression_identifier != stream.strf_vids->compression_identifier) ||
+                    (stream_entry.width != stream.strf_vids->width) ||
+                    (stream_entry.height != stream.strf_vids->height) ||
+                    (stream_entry.frame_count != stream.frames.size()) ||
+                    (stream_entry.rate != stream.strh->rate) ||
+                    (stream_entry.scale != stream.strh->scale) ||
+                    (!stream_entry.huffyuv) ||
+                    (stream_entry.valid != codec.is_valid()) ||
+                    (stream_entry.format != codec.get_image_format()) ||
+                    (stream_entry.predictor != codec.get_image_predictor()) ||
+                    (stream_entry.interlaced != codec.is_interlaced()) ||
+                    (stream_entry.decorrelated != codec.is_decorrelated())
+                ) {
+                    std::fprintf(stderr, "Failed to match catalog of stream %zu of sample '%s' with variant %d.\n", stream_number, sample_names[index_sample].c_str(), variant);
+                    return 1;
+                }
+            }
+            if (index_entry != entry->streams.size()) {
+                std::fprintf(stderr, "Failed to match the streams catalogued of sample '%s' with variant %d.\n", sample_names[index_sample].c_str(), variant);
+                return 1;
+            }
+        }
+        if ((entries.front().path != truncated_path) || (entries.front().parsed)) {
+            std::fprintf(stderr, "Failed to catalog truncated avi as unreadable with variant %d.\n", variant);
+            return 1;
+        }
+
+        // One line per stream and a summary.
+        const char* report_path = "catalog_samples_report.txt";
+        std::FILE* report_file = std::fopen(report_path, "w+b");
+        if ((report_file == nullptr) || (!catalog.write_report(report_file))) {
+            std::fprintf(stderr, "Failed to write catalog report with variant %d.\n", variant);
+            return 1;
+        }
+        const long report_length = std::ftell(report_file);
+        reports[variant].resize(static_cast<size_t>(report_length));
+        std::rewind(report_file);
+        if ((report_length <= 0) || (std::fread(&reports[variant][0], 1, reports[variant].size(), report_file) != reports[variant].size())) {
+            std::fprintf(stderr, "Failed to read catalog report with variant %d.\n", variant);
+            return 1;
+        }
+        std::fclose(report_file);
+        std::remove(report_path);
+    }
+    if ((reports[0] != reports[1]) || (reports[0].find("unreadable") == std::string::npos) || (reports[0].find("huffyuv") == std::string::npos)) {
+        std::fprintf(stderr, "Failed to match catalog reports.\n");
+        return 1;
+    }
+    std::remove(truncated_path);
+
+    return 0;
+}
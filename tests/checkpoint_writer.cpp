@@ -0,0 +1,119 @@
+#include <avi.hpp>
+#include <avi_writer.hpp>
+
+#include "samples.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    const char* path = "checkpoint_writer.avi";
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        const avi::stream_type& stream = video.get_stream(0);
+        if ((stream.strf_vids == nullptr) || (stream.frames.empty())) {
+            continue;
+        }
+
+        std::vector<avi::stream_type> streams(1);
+        streams[0].strh = stream.strh;
+        streams[0].strf_vids = stream.strf_vids;
+        unsigned long long int largest_frame = 0;
+        for (const avi::frame_type& frame : stream.frames) {
+            largest_frame = (frame.length > largest_frame) ? frame.length : largest_frame;
+        }
+        avi::avih_type avih = *video.get_avih();
+        avih.stream_count = 1;
+
+        // Checkpoint about every four frames and split RIFF chunks about every ten, through the page cache and with direct I/O.
+        const unsigned long long int checkpoint_interval = 4 * largest_frame;
+        const size_t frame_count = 3 * stream.frames.size();
+        for (int variant = 0; variant < 2; ++variant) {
+            const avi_writer::io_type io = (variant == 0) ? avi_writer::io_type::buffered : avi_writer::io_type::direct;
+            avi_writer writer;
+            if (!writer.open(path, &avih, streams, 10 * (8 + largest_frame + 1), avi_writer::default_super_index_capacity, 1, io, checkpoint_interval)) {
+                std::fprintf(stderr, "Failed to open avi writer variant %d for sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+
+            for (size_t index_frame = 0; index_frame < frame_count; ++index_frame) {
+                const avi::frame_type& frame = stream.frames[index_frame % stream.frames.size()];
+                if (!writer.write_frame(0, frame.data, frame.length)) {
+                    std::fprintf(stderr, "Failed to write frame %zu with avi writer variant %d for sample '%s'.\n", index_frame, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+                const size_t frames_written = index_frame + 1;
+
+                // Read the file as it would be left if the writer died now, it must hold every frame up to a recent checkpoint.
+                unsigned long long int unchecked_bytes = 0;
+                size_t frames_found = 0;
+                avi video_partial;
+                if (video_partial.open(path, avi::access_type::random, false)) {
+                    frames_found = static_cast<size_t>(video_partial.get_frame_count(0));
+                    if (frames_found > frames_written) {
+                        std::fprintf(stderr, "Failed to limit checkpoint to the %zu frames written with avi writer variant %d for sample '%s'.\n", frames_written, variant, sample_names[index_sample].c_str());
+                        return 1;
+                    }
+                    for (size_t index_found = 0; index_found < frames_found; ++index_found) {
+                        const avi::frame_type& expected = stream.frames[index_found % stream.frames.size()];
+                        avi::frame_type found;
+                        if ((!video_partial.get_frame(0, index_found, found)) || (found.length != expected.length) || (std::memcmp(found.data, expected.data, found.length) != 0)) {
+                            std::fprintf(stderr, "Failed to match frame %zu of checkpoint with avi writer variant %d for sample '%s'.\n", index_found, variant, sample_names[index_sample].c_str());
+                            return 1;
+                        }
+                    }
+                }
+                for (size_t index_unchecked = frames_found; index_unchecked < frames_written; ++index_unchecked) {
+                    unchecked_bytes += 8 + stream.frames[index_unchecked % stream.frames.size()].length;
+                }
+                if (unchecked_bytes >= checkpoint_interval + 8 + largest_frame + 1) {
+                    std::fprintf(stderr, "Failed to checkpoint %zu frames written with avi writer variant %d for sample '%s'.\n", frames_written, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+            }
+
+            if (!writer.close()) {
+                std::fprintf(stderr, "Failed to close avi writer variant %d for sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+
+            // Once closed the file is complete, the indexes left by checkpoints are skipped as JUNK.
+            for (int load_frames = 0; load_frames < 2; ++load_frames) {
+                avi video_written;
+                if ((!video_written.open(path, avi::access_type::random, load_frames != 0)) || (video_written.get_frame_count(0) != frame_count) || ((video_written.get_avih()->flags & avi::avih_flag_has_index) == 0)) {
+                    std::fprintf(stderr, "Failed to find all frames written with avi writer variant %d for sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+                for (size_t index_frame = 0; index_frame < frame_count; ++index_frame) {
+                    const avi::frame_type& expected = stream.frames[index_frame % stream.frames.size()];
+                    avi::frame_type found;
+                    if ((!video_written.get_frame(0, index_frame, found)) || (found.length != expected.length) || (std::memcmp(found.data, expected.data, found.length) != 0)) {
+                        std::fprintf(stderr, "Failed to match frame %zu written with avi writer variant %d for sample '%s'.\n", index_frame, variant, sample_names[index_sample].c_str());
+                        return 1;
+                    }
+                }
+            }
+            std::remove(path);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <avi.hpp>
+
+#include "samples.hpp"
+
+#include <cstring>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        const avi::stream_type& stream = video.get_stream(0);
+        if (stream.strf_vids == nullptr) {
+            continue;
+        }
+
+        std::vector<avi::stream_type> streams(1);
+        streams[0].strh = stream.strh;
+        streams[0].strf_vids = stream.strf_vids;
+        streams[0].frames = stream.frames;
+        unsigned long long int largest_frame = 0;
+        unsigned long long int frame_data_length = 0;
+        size_t frames_with_data = 0;
+        for (const avi::frame_type& frame : stream.frames) {
+            largest_frame = (frame.length > largest_frame) ? frame.length : largest_frame;
+            frame_data_length += frame.length;
+            frames_with_data += (frame.length > 0) ? 1 : 0;
+        }
+        avi::avih_type avih = *video.get_avih();
+        avih.stream_count = 1;
+
+        // Compose in a single RIFF chunk and with room for about two frames in each RIFF chunk.
+        for (int variant = 0; variant < 2; ++variant) {
+            const unsigned long long int segment_size = (variant == 0) ? avi::default_segment_size : 2 * (8 + largest_frame + 1);
+            std::vector<unsigned char> composed;
+            if (!video.compose(&avih, streams, composed, segment_size)) {
+                std::fprintf(stderr, "Failed to compose avi variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            std::vector<unsigned char> framing;
+            std::vector<avi::gather_type> gathers;
+            if (!video.compose(&avih, streams, framing, gathers, segment_size)) {
+                std::fprintf(stderr, "Failed to compose gathered avi variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+
+            // The frame data is referenced in place, only the framing is written.
+            size_t frames_referenced = 0;
+            std::vector<unsigned char> gathered;
+            for (const avi::gather_type& gather : gathers) {
+                const bool in_framing = (gather.data >= framing.data()) && (gather.data + gather.length <= framing.data() + framing.size());
+                const bool in_file = (gather.data >= file.get()) && (gather.data + gather.length <= file.get() + length);
+                if (in_file) {
+                    ++frames_referenced;
+                }
+                else if (!in_framing) {
+                    std::fprintf(stderr, "Failed to find the source of a gather in avi variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+                gathered.insert(gathered.end(), gather.data, gather.data + gather.length);
+            }
+            if ((framing.size() + frame_data_length != composed.size()) || (frames_referenced != frames_with_data)) {
+                std::fprintf(stderr, "Failed to reference the frames in gathered avi variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            if ((gathered.size() != composed.size()) || (std::memcmp(gathered.data(), composed.data(), composed.size()) != 0)) {
+                std::fprintf(stderr, "Failed to match gathered avi variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
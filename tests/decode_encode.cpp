@@ -93,7 +93,7 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
 
-            unsigned long long int pixels_encoded_length = codec_decode.get_decoded_image_size();
+            unsigned long long int pixels_encoded_length = codec_encode.get_max_encoded_size();
             std::unique_ptr<unsigned char[]> pixels_encoded = std::unique_ptr<unsigned char[]>(new unsigned char[pixels_encoded_length]);
             if (!codec_encode.encode(
                 pixels_decoded.get(),
@@ -0,0 +1,107 @@
+#include <avi.hpp>
+#include <avi_demuxer.hpp>
+
+#include "samples.hpp"
+
+#include <cstring>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Size the buffer to just hold the largest frame along with some space for the headers.
+        unsigned long long int largest_frame = 0;
+        for (size_t index_stream = 0; index_stream < video.get_streams(); ++index_stream) {
+            for (const avi::frame_type& frame : video.get_frames(index_stream)) {
+                largest_frame = (frame.length > largest_frame) ? frame.length : largest_frame;
+            }
+        }
+        const unsigned long long int buffer_capacity = 8 + largest_frame + 4096;
+
+        // Demux the whole file pushed in small uneven pieces, then half the file pulled from a source.
+        for (int truncated = 0; truncated < 2; ++truncated) {
+            avi_demuxer demuxer(buffer_capacity);
+            std::vector<size_t> frame_counts(video.get_streams(), 0);
+            const size_t stream_length = truncated ? (length / 2) : length;
+            size_t stream_index = 0;
+
+            avi::frame_type frame;
+            unsigned int stream_number = 0;
+            avi_demuxer::result_type result = avi_demuxer::result_type::need_data;
+            for (;;) {
+                if (truncated) {
+                    result = demuxer.next(frame, stream_number, [&](unsigned char* data, unsigned long long int data_length) -> unsigned long long int {
+                        const unsigned long long int read_length = std::min<unsigned long long int>(data_length, std::min<size_t>(stream_length - stream_index, 3000));
+                        std::memcpy(data, &file[stream_index], read_length);
+                        stream_index += read_length;
+                        return read_length;
+                    });
+                }
+                else {
+                    result = demuxer.next(frame, stream_number);
+                    if (result == avi_demuxer::result_type::need_data) {
+                        if (stream_index == stream_length) {
+                            demuxer.finish();
+                        }
+                        else {
+                            stream_index += demuxer.push(&file[stream_index], std::min<size_t>(stream_length - stream_index, 4099));
+                        }
+                        continue;
+                    }
+                }
+                if (result != avi_demuxer::result_type::frame) {
+                    break;
+                }
+
+                if (stream_number >= video.get_streams()) {
+                    fprintf(stderr, "Failed to demux a valid stream number for sample '%s'.\n", sample_names[index_sample].c_str());
+                    return 1;
+                }
+                const std::vector<avi::frame_type>& frames = video.get_frames(stream_number);
+                const size_t index_frame = frame_counts[stream_number]++;
+                if (
+                    (index_frame >= frames.size()) ||
+                    (frames[index_frame].length != frame.length) ||
+                    (std::memcmp(frames[index_frame].data, frame.data, frame.length) != 0)
+                ) {
+                    fprintf(stderr, "Failed to match demuxed frame %zu of stream %u for sample '%s'.\n", index_frame, stream_number, sample_names[index_sample].c_str());
+                    return 1;
+                }
+            }
+
+            if (result != avi_demuxer::result_type::end) {
+                fprintf(stderr, "Failed to demux to the end of sample '%s'.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+            for (size_t index_stream = 0; index_stream < video.get_streams(); ++index_stream) {
+                if ((!truncated) && (frame_counts[index_stream] != video.get_frames(index_stream).size())) {
+                    fprintf(stderr, "Failed to demux all frames of stream %zu for sample '%s'.\n", index_stream, sample_names[index_sample].c_str());
+                    return 1;
+                }
+            }
+            if ((!demuxer.has_headers()) || (demuxer.get_headers().get_streams() != video.get_streams())) {
+                fprintf(stderr, "Failed to demux headers for sample '%s'.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <avi.hpp>
+#include <avi_writer.hpp>
+
+#include "samples.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    const char* path = "direct_writer.avi";
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        const avi::stream_type& stream = video.get_stream(0);
+        if ((stream.strf_vids == nullptr) || (stream.frames.empty())) {
+            continue;
+        }
+
+        std::vector<avi::stream_type> streams(1);
+        streams[0].strh = stream.strh;
+        streams[0].strf_vids = stream.strf_vids;
+        unsigned long long int frame_data_length = 0;
+        for (const avi::frame_type& frame : stream.frames) {
+            frame_data_length += frame.length;
+        }
+        avi::avih_type avih = *video.get_avih();
+        avih.stream_count = 1;
+
+        // Write the frames over and over, enough to fill both staging buffers more than once.
+        // RIFF chunks are split often, so sizes are patched both into staged data and into data already written.
+        // There are no checkpoints, the file is synced after each staging buffer from the I/O thread.
+        const size_t repeats = static_cast<size_t>((3 * avi_writer::staging_size) / (frame_data_length + 1) + 1);
+        avi_writer writer;
+        if (!writer.open(path, &avih, streams, avi_writer::staging_size / 3, avi_writer::default_super_index_capacity, avi::direct_io_alignment, avi_writer::io_type::direct, 0, avi_writer::staging_size)) {
+            std::fprintf(stderr, "Failed to open direct avi writer for sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        for (size_t repeat = 0; repeat < repeats; ++repeat) {
+            for (const avi::frame_type& frame : stream.frames) {
+                if (!writer.write_frame(0, frame.data, frame.length)) {
+                    std::fprintf(stderr, "Failed to write frame with direct I/O for sample '%s'.\n", sample_names[index_sample].c_str());
+                    return 1;
+                }
+            }
+        }
+        if (!writer.close()) {
+            std::fprintf(stderr, "Failed to close direct avi writer for sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Read the file back, it must have been truncated to its real length for the RIFF chunks to be found.
+        avi video_written;
+        if (!video_written.open(path)) {
+            std::fprintf(stderr, "Failed to open avi written with direct I/O for sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        const std::vector<avi::frame_type>& frames = video_written.get_frames(0);
+        if ((frames.size() != repeats * stream.frames.size()) || (video_written.get_stream(0).strh->length != frames.size())) {
+            std::fprintf(stderr, "Failed to find all frames in avi written with direct I/O for sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        for (size_t index_frame = 0; index_frame < frames.size(); ++index_frame) {
+            const avi::frame_type& frame = stream.frames[index_frame % stream.frames.size()];
+            if (
+                (video_written.get_frame_offset(frames[index_frame]) % avi::direct_io_alignment != 0) ||
+                (frames[index_frame].length != frame.length) ||
+                (std::memcmp(frames[index_frame].data, frame.data, frame.length) != 0)
+            ) {
+                std::fprintf(stderr, "Failed to match frame %zu in avi written with direct I/O for sample '%s'.\n", index_frame, sample_names[index_sample].c_str());
+                return 1;
+            }
+        }
+        video_written.close();
+        std::remove(path);
+    }
+
+    return 0;
+}
@@ -4,6 +4,8 @@
 #include "convert.hpp"
 #include "samples.hpp"
 
+#include <cstring>
+
 int main(int argc, char* argv[]) {
     static_cast<void>(argc);
     static_cast<void>(argv);
@@ -95,7 +97,7 @@ int main(int argc, char* argv[]) {
             const unsigned long long int pixels_length = 3 * width * height;
 
             // Frame encoding using the huffyuv class.
-            unsigned long long int pixels_encoded_length = codec_encode.get_decoded_image_size();
+            unsigned long long int pixels_encoded_length = codec_encode.get_max_encoded_size();
             std::unique_ptr<unsigned char[]> pixels_encoded = std::unique_ptr<unsigned char[]>(new unsigned char[pixels_encoded_length]);
             if (!codec_encode.encode(
                 pixels.get(),
@@ -126,6 +128,35 @@ int main(int argc, char* argv[]) {
             return 1;
         }
 
+        // The generated avi must advertise its idx1 index, with every frame marked as a keyframe.
+        if ((video_decode.get_avih()->flags & avi::avih_flag_has_index) == 0) {
+            std::fprintf(stderr, "Failed to find index flag in generated avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        unsigned int riff_length = 0;
+        std::memcpy(&riff_length, &avi_data[4], 4);
+        size_t index_entries = 0;
+        for (size_t offset = 12; offset + 8 <= 8ull + riff_length; ) {
+            unsigned int chunk_length = 0;
+            std::memcpy(&chunk_length, &avi_data[offset + 4], 4);
+            if (std::memcmp(&avi_data[offset], "idx1", 4) == 0) {
+                for (size_t entry = 0; entry < chunk_length / sizeof(avi::index_type); ++entry) {
+                    avi::index_type index;
+                    std::memcpy(&index, &avi_data[offset + 8 + entry * sizeof(avi::index_type)], sizeof(avi::index_type));
+                    if ((index.flags & avi::index_flag_keyframe) == 0) {
+                        std::fprintf(stderr, "Failed to find keyframe flag for index entry %zu in generated avi of sample '%s'.\n", entry, sample_names[index_sample].c_str());
+                        return 1;
+                    }
+                    ++index_entries;
+                }
+            }
+            offset += 8 + chunk_length + (chunk_length % 2);
+        }
+        if (index_entries != sample_frames[index_sample]) {
+            std::fprintf(stderr, "Failed to find an index entry for every frame in generated avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
         // Select stream.
         unsigned int stream_number = 0xFFFFFFFF;
         for (size_t i = 0; i < video_decode.get_streams(); ++i) {
@@ -0,0 +1,199 @@
+#include <avi.hpp>
+#include <huffyuv.hpp>
+
+#include "samples.hpp"
+#include "convert.hpp"
+
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Select stream.
+        unsigned int stream_number = 0xFFFFFFFF;
+        for (size_t i = 0; i < video.get_streams(); ++i) {
+            const avi::stream_type& stream = video.get_stream(i);
+            if (
+                (stream.strh->type == avi::fourcc("vids")) &&
+                ((stream.strh->handler == avi::fourcc("hfyu")) || (stream.strh->handler == avi::fourcc("HFYU")))
+            ) {
+                if (
+                    (stream.strf_vids != nullptr) &&
+                    (stream.strf_vids->compression_identifier == avi::fourcc("HFYU"))
+                ) {
+                    stream_number = i;
+                    break;
+                }
+            }
+        }
+        if (stream_number == 0xFFFFFFFF) {
+            std::fprintf(stderr, "Failed find a HFYU encoded video stream inside the avi file.\n");
+            return 1;
+        }
+
+        // Setup decode codec.
+        huffyuv codec_decode(reinterpret_cast<const unsigned char*>(video.get_stream(stream_number).strf_vids), video.get_stream(stream_number).strf_vids->header_size);
+        if (!codec_decode.is_valid()) {
+            fprintf(stderr, "Failed setup huffyuv decoder for sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode all the frames.
+        std::vector<std::unique_ptr<unsigned char[]>> frames_decoded;
+        for (size_t index_frame = 0; index_frame < sample_frames[index_sample]; ++index_frame) {
+            unsigned long long int pixels_decoded_length = codec_decode.get_decoded_image_size();
+            std::unique_ptr<unsigned char[]> pixels_decoded = std::unique_ptr<unsigned char[]>(new unsigned char[pixels_decoded_length]);
+            if (!codec_decode.decode(
+                video.get_stream(stream_number).frames[index_frame].data,
+                video.get_stream(stream_number).frames[index_frame].length,
+                pixels_decoded.get(),
+                pixels_decoded_length
+            )) {
+                fprintf(stderr, "Failed to decode frame %zu/%zu for sample '%s'.\n", index_frame, sample_frames[index_sample], sample_names[index_sample].c_str());
+                return 1;
+            }
+            frames_decoded.push_back(std::move(pixels_decoded));
+        }
+
+        // The classic predictor cannot store tables, so use the left predictor instead.
+        const huffyuv::predictor_type predictor = (codec_decode.get_image_predictor() == huffyuv::predictor_type::classic) ? huffyuv::predictor_type::left : codec_decode.get_image_predictor();
+
+        // Generate tables optimised for size and then for decode speed, both must round trip.
+        for (const huffyuv::optimisation_type optimisation : { huffyuv::optimisation_type::size, huffyuv::optimisation_type::decode_speed }) {
+            // Setup encode codecs, one with the builtin tables and one with optimised tables.
+            huffyuv codec_encode_builtin(
+                codec_decode.get_image_width(),
+                codec_decode.get_image_height(),
+                codec_decode.is_interlaced(),
+                codec_decode.is_decorrelated(),
+                codec_decode.get_image_format(),
+                predictor
+            );
+            huffyuv codec_encode_optimised(
+                codec_decode.get_image_width(),
+                codec_decode.get_image_height(),
+                codec_decode.is_interlaced(),
+                codec_decode.is_decorrelated(),
+                codec_decode.get_image_format(),
+                predictor
+            );
+            if ((!codec_encode_builtin.is_valid()) || (!codec_encode_optimised.is_valid())) {
+                fprintf(stderr, "Failed setup huffyuv encoders for sample '%s'.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+
+            // Collect the residual histograms and generate tables from them.
+            huffyuv::histogram_type histogram = {};
+            for (size_t index_frame = 0; index_frame < frames_decoded.size(); ++index_frame) {
+                if (!codec_encode_optimised.analyse(frames_decoded[index_frame].get(), codec_encode_optimised.get_decoded_image_size(), histogram)) {
+                    fprintf(stderr, "Failed to analyse frame %zu for sample '%s'.\n", index_frame, sample_names[index_sample].c_str());
+                    return 1;
+                }
+            }
+            if (!codec_encode_optimised.optimise_tables(histogram, optimisation)) {
+                fprintf(stderr, "Failed to optimise tables for sample '%s'.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+
+            // Generate the stream header containing the optimised tables and setup a decoder from it.
+            const unsigned int strf_vids_size = sizeof(avi::strf_vids_type) + 4 + codec_encode_optimised.get_packed_table_size();
+            std::unique_ptr<unsigned char[]> strf_vids_data = std::unique_ptr<unsigned char[]>(new unsigned char[strf_vids_size]);
+            if (!codec_encode_optimised.generate_stream_header(strf_vids_data.get(), strf_vids_size)) {
+                fprintf(stderr, "Failed to generate stream header for sample '%s'.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+            huffyuv codec_decode_optimised(strf_vids_data.get(), strf_vids_size);
+            if (!codec_decode_optimised.is_valid()) {
+                fprintf(stderr, "Failed setup huffyuv decoder from optimised stream header for sample '%s'.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+
+            // The residuals counted while encoding must match the analysed residuals.
+            huffyuv::histogram_type histogram_encoded = {};
+
+            unsigned long long int total_builtin_length = 0;
+            unsigned long long int total_optimised_length = 0;
+            for (size_t index_frame = 0; index_frame < frames_decoded.size(); ++index_frame) {
+                unsigned long long int pixels_builtin_length = codec_encode_builtin.get_max_encoded_size();
+                std::unique_ptr<unsigned char[]> pixels_builtin = std::unique_ptr<unsigned char[]>(new unsigned char[pixels_builtin_length]);
+                if (!codec_encode_builtin.encode(
+                    frames_decoded[index_frame].get(),
+                    codec_encode_builtin.get_decoded_image_size(),
+                    pixels_builtin.get(),
+                    pixels_builtin_length,
+                    &histogram_encoded
+                )) {
+                    fprintf(stderr, "Failed to encode frame %zu/%zu with builtin tables for sample '%s'.\n", index_frame, sample_frames[index_sample], sample_names[index_sample].c_str());
+                    return 1;
+                }
+                total_builtin_length += pixels_builtin_length;
+
+                unsigned long long int pixels_encoded_length = codec_encode_optimised.get_max_encoded_size();
+                std::unique_ptr<unsigned char[]> pixels_encoded = std::unique_ptr<unsigned char[]>(new unsigned char[pixels_encoded_length]);
+                if (!codec_encode_optimised.encode(
+                    frames_decoded[index_frame].get(),
+                    codec_encode_optimised.get_decoded_image_size(),
+                    pixels_encoded.get(),
+                    pixels_encoded_length
+                )) {
+                    fprintf(stderr, "Failed to encode frame %zu/%zu with optimised tables for sample '%s'.\n", index_frame, sample_frames[index_sample], sample_names[index_sample].c_str());
+                    return 1;
+                }
+                total_optimised_length += pixels_encoded_length;
+
+                unsigned long long int pixels_decoded_length = codec_decode_optimised.get_decoded_image_size();
+                std::unique_ptr<unsigned char[]> pixels_decoded = std::unique_ptr<unsigned char[]>(new unsigned char[pixels_decoded_length]);
+                if (!codec_decode_optimised.decode(
+                    pixels_encoded.get(),
+                    pixels_encoded_length,
+                    pixels_decoded.get(),
+                    pixels_decoded_length
+                )) {
+                    fprintf(stderr, "Failed to decode frame %zu/%zu with optimised tables for sample '%s'.\n", index_frame, sample_frames[index_sample], sample_names[index_sample].c_str());
+                    return 1;
+                }
+
+                for (size_t index_byte = 0; index_byte < pixels_decoded_length; ++index_byte) {
+                    if (pixels_decoded.get()[index_byte] != frames_decoded[index_frame].get()[index_byte]) {
+                        fprintf(stderr, "Failed to match frame %zu for sample '%s' at byte %zu.\n", index_frame, sample_names[index_sample].c_str(), index_byte);
+                        return 1;
+                    }
+                }
+            }
+
+            for (int table_index = 0; table_index < 3; ++table_index) {
+                for (int value = 0; value < 256; ++value) {
+                    if (histogram_encoded.counts[table_index][value] != histogram.counts[table_index][value]) {
+                        fprintf(stderr, "Failed to match encoded histogram for sample '%s' at table %d value %d.\n", sample_names[index_sample].c_str(), table_index, value);
+                        return 1;
+                    }
+                }
+            }
+
+            // Tables optimised for size should never do worse than the builtin tables.
+            if ((optimisation == huffyuv::optimisation_type::size) && (total_optimised_length > total_builtin_length)) {
+                fprintf(stderr, "Failed to improve on builtin tables for sample '%s', %llu > %llu bytes.\n", sample_names[index_sample].c_str(), total_optimised_length, total_builtin_length);
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <huffyuv.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    const huffyuv::format_type formats[3] = { huffyuv::format_type::yuyv, huffyuv::format_type::bgr, huffyuv::format_type::bgra };
+    const char* format_names[3] = { "yuyv", "bgr", "bgra" };
+
+    for (int index_format = 0; index_format < 3; ++index_format) {
+        const bool decorrelated = (formats[index_format] != huffyuv::format_type::yuyv);
+        huffyuv codec(64, 48, false, decorrelated, formats[index_format], huffyuv::predictor_type::left);
+        if (!codec.is_valid()) {
+            fprintf(stderr, "Failed setup huffyuv codec for format '%s'.\n", format_names[index_format]);
+            return 1;
+        }
+
+        // Noise does not compress so must fail to encode as a HFYU frame and be stored uncompressed when allowed, a flat image must compress.
+        for (int noise = 1; noise >= 0; --noise) {
+            const unsigned long long int frame_length = codec.get_decoded_image_size();
+            std::unique_ptr<unsigned char[]> frame = std::unique_ptr<unsigned char[]>(new unsigned char[frame_length]);
+            unsigned int state = 12345;
+            for (unsigned long long int index_byte = 0; index_byte < frame_length; ++index_byte) {
+                state = state * 1103515245 + 12345;
+                frame[index_byte] = noise ? static_cast<unsigned char>(state >> 16) : 100;
+            }
+
+            unsigned long long int encoded_length = codec.get_max_encoded_size();
+            std::unique_ptr<unsigned char[]> encoded = std::unique_ptr<unsigned char[]>(new unsigned char[encoded_length]);
+            if (codec.encode(frame.get(), frame_length, encoded.get(), encoded_length) == static_cast<bool>(noise)) {
+                fprintf(stderr, "Failed to %s %s frame as a HFYU frame for format '%s'.\n", noise ? "reject" : "encode", noise ? "noise" : "flat", format_names[index_format]);
+                return 1;
+            }
+            encoded_length = codec.get_max_encoded_size();
+            bool stored = !noise;
+            if ((!codec.encode(frame.get(), frame_length, encoded.get(), encoded_length, stored)) || (stored != static_cast<bool>(noise))) {
+                fprintf(stderr, "Failed to encode %s frame for format '%s'.\n", noise ? "noise" : "flat", format_names[index_format]);
+                return 1;
+            }
+            if ((noise) && (encoded_length != frame_length)) {
+                fprintf(stderr, "Failed to store noise frame uncompressed for format '%s', %llu bytes.\n", format_names[index_format], encoded_length);
+                return 1;
+            }
+            // Stored RGB frames are bottom-up, YUY2 frames are top-down.
+            const unsigned long long int row_length = frame_length / 48;
+            for (unsigned long long int row = 0; (noise) && (row < 48); ++row) {
+                const unsigned long long int source_row = (formats[index_format] == huffyuv::format_type::yuyv) ? row : (47 - row);
+                if (std::memcmp(&encoded[row * row_length], &frame[source_row * row_length], row_length) != 0) {
+                    fprintf(stderr, "Failed to match stored noise frame for format '%s' at row %llu.\n", format_names[index_format], row);
+                    return 1;
+                }
+            }
+            if ((!noise) && (encoded_length >= codec.get_max_encoded_size())) {
+                fprintf(stderr, "Failed to compress flat frame for format '%s', %llu bytes.\n", format_names[index_format], encoded_length);
+                return 1;
+            }
+            if (noise) {
+                // A stored frame is written as an uncompressed '##db' chunk and never decoded.
+                continue;
+            }
+
+            unsigned long long int decoded_length = codec.get_decoded_image_size();
+            std::unique_ptr<unsigned char[]> decoded = std::unique_ptr<unsigned char[]>(new unsigned char[decoded_length]);
+            if (!codec.decode(encoded.get(), encoded_length, decoded.get(), decoded_length)) {
+                fprintf(stderr, "Failed to decode %s frame for format '%s'.\n", noise ? "noise" : "flat", format_names[index_format]);
+                return 1;
+            }
+            for (unsigned long long int index_byte = 0; index_byte < frame_length; ++index_byte) {
+                if (decoded[index_byte] != frame[index_byte]) {
+                    fprintf(stderr, "Failed to match %s frame for format '%s' at byte %llu.\n", noise ? "noise" : "flat", format_names[index_format], index_byte);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
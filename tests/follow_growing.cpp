@@ -0,0 +1,105 @@
+#include <avi.hpp>
+#include <avi_reader.hpp>
+#include <avi_writer.hpp>
+
+#include "samples.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    const char* path = "follow_growing.avi";
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        const avi::stream_type& stream = video.get_stream(0);
+        if ((stream.strf_vids == nullptr) || (stream.frames.empty())) {
+            continue;
+        }
+
+        std::vector<avi::stream_type> streams(1);
+        streams[0].strh = stream.strh;
+        streams[0].strf_vids = stream.strf_vids;
+        unsigned long long int largest_frame = 0;
+        for (const avi::frame_type& frame : stream.frames) {
+            largest_frame = (frame.length > largest_frame) ? frame.length : largest_frame;
+        }
+        avi::avih_type avih = *video.get_avih();
+        avih.stream_count = 1;
+
+        // Follow a buffered capture with room for about two frames in each RIFF chunk, and a direct I/O capture that checkpoints after every frame.
+        // The direct I/O capture pads the file with zeros past the frames written until it is closed.
+        for (int variant = 0; variant < 2; ++variant) {
+            avi_writer writer;
+            const bool opened = (variant == 0) ?
+                writer.open(path, &avih, streams, 2 * (8 + largest_frame + 1)) :
+                writer.open(path, &avih, streams, avi::default_segment_size, avi_writer::default_super_index_capacity, avi::direct_io_alignment, avi_writer::io_type::direct, 1);
+            if (!opened) {
+                std::fprintf(stderr, "Failed to open avi writer variant %d for sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            if ((variant == 1) && (!writer.write_frame(0, stream.frames[0].data, stream.frames[0].length))) {
+                std::fprintf(stderr, "Failed to write first frame variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+
+            // Once the headers are written the capture can be followed, every frame must be previewed as soon as it is written.
+            avi_reader reader;
+            if ((!reader.open_growing(path, 0, 2 * largest_frame)) || (reader.get_frame_count() != static_cast<unsigned long long int>(variant))) {
+                std::fprintf(stderr, "Failed to open growing avi reader variant %d for sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            for (size_t index_frame = 0; index_frame < stream.frames.size(); ++index_frame) {
+                const avi::frame_type& expected = stream.frames[index_frame];
+                if ((index_frame >= static_cast<size_t>(variant)) && (!writer.write_frame(0, expected.data, expected.length))) {
+                    std::fprintf(stderr, "Failed to write frame %zu variant %d of sample '%s'.\n", index_frame, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+                avi::frame_type frame;
+                unsigned long long int frame_number = 0;
+                if ((!reader.refresh()) || (reader.get_frame_count() != index_frame + 1) || (!reader.acquire_frame(frame, frame_number)) || (frame_number != index_frame)) {
+                    std::fprintf(stderr, "Failed to follow frame %zu variant %d of sample '%s'.\n", index_frame, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+                if ((frame.length != expected.length) || (std::memcmp(frame.data, expected.data, frame.length) != 0)) {
+                    std::fprintf(stderr, "Failed to match followed frame %zu variant %d of sample '%s'.\n", index_frame, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+                reader.release_frame(frame_number);
+            }
+
+            // Closing the capture adds indexes but no frames.
+            if (!writer.close()) {
+                std::fprintf(stderr, "Failed to close avi writer variant %d for sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            avi::frame_type frame;
+            unsigned long long int frame_number = 0;
+            if ((!reader.refresh()) || (reader.get_frame_count() != stream.frames.size()) || (reader.acquire_frame(frame, frame_number))) {
+                std::fprintf(stderr, "Failed to follow the end of the capture variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            reader.close();
+            std::remove(path);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <avi.hpp>
+#include <avi_writer.hpp>
+
+#include "samples.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    const char* path = "frame_alignment.avi";
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        const avi::stream_type& stream = video.get_stream(0);
+        if (stream.strf_vids == nullptr) {
+            continue;
+        }
+
+        std::vector<avi::stream_type> streams(1);
+        streams[0].strh = stream.strh;
+        streams[0].strf_vids = stream.strf_vids;
+        streams[0].frames = stream.frames;
+        unsigned long long int largest_frame = 0;
+        for (const avi::frame_type& frame : stream.frames) {
+            largest_frame = (frame.length > largest_frame) ? frame.length : largest_frame;
+        }
+        avi::avih_type avih = *video.get_avih();
+        avih.stream_count = 1;
+
+        // Alignments that are not a power of two are rejected.
+        std::vector<unsigned char> rejected;
+        if ((video.compose(&avih, streams, rejected, avi::default_segment_size, 0)) || (video.compose(&avih, streams, rejected, avi::default_segment_size, 48))) {
+            std::fprintf(stderr, "Failed to reject an invalid frame alignment for sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Compose and write with small and direct I/O alignments, in a single RIFF chunk and with room for about two aligned frames in each.
+        const unsigned int alignments[] = { 4, 512, avi::direct_io_alignment };
+        for (const unsigned int alignment : alignments) {
+            for (int variant = 0; variant < 2; ++variant) {
+                const unsigned long long int segment_size = (variant == 0) ? avi::default_segment_size : 2 * (alignment + 6 + 8 + largest_frame + 1);
+                std::vector<unsigned char> composed;
+                if (!video.compose(&avih, streams, composed, segment_size, alignment)) {
+                    std::fprintf(stderr, "Failed to compose avi aligned to %u, variant %d, of sample '%s'.\n", alignment, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+
+                avi_writer writer;
+                if (!writer.open(path, &avih, streams, segment_size, avi_writer::default_super_index_capacity, alignment)) {
+                    std::fprintf(stderr, "Failed to open avi writer aligned to %u, variant %d, for sample '%s'.\n", alignment, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+                for (const avi::frame_type& frame : stream.frames) {
+                    if (!writer.write_frame(0, frame.data, frame.length)) {
+                        std::fprintf(stderr, "Failed to write frame aligned to %u, variant %d, of sample '%s'.\n", alignment, variant, sample_names[index_sample].c_str());
+                        return 1;
+                    }
+                }
+                if (!writer.close()) {
+                    std::fprintf(stderr, "Failed to close avi writer aligned to %u, variant %d, for sample '%s'.\n", alignment, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+
+                // Look up every frame through the indexes of the composed and written files, the data must start on the alignment and match.
+                for (int source = 0; source < 2; ++source) {
+                    avi video_aligned;
+                    const bool parsed = (source == 0) ? video_aligned.parse(composed.data(), composed.size(), false) : video_aligned.open(path, avi::access_type::random, false);
+                    if (!parsed) {
+                        std::fprintf(stderr, "Failed to parse avi aligned to %u, variant %d, source %d, of sample '%s'.\n", alignment, variant, source, sample_names[index_sample].c_str());
+                        return 1;
+                    }
+                    if ((video_aligned.get_avih()->padding_granularity != alignment) || (video_aligned.get_frame_count(0) != stream.frames.size())) {
+                        std::fprintf(stderr, "Failed to match the headers of avi aligned to %u, variant %d, source %d, of sample '%s'.\n", alignment, variant, source, sample_names[index_sample].c_str());
+                        return 1;
+                    }
+                    for (size_t index_frame = 0; index_frame < stream.frames.size(); ++index_frame) {
+                        avi::frame_type frame;
+                        if (!video_aligned.get_frame(0, index_frame, frame)) {
+                            std::fprintf(stderr, "Failed to look up frame %zu in avi aligned to %u, variant %d, source %d, of sample '%s'.\n", index_frame, alignment, variant, source, sample_names[index_sample].c_str());
+                            return 1;
+                        }
+                        if (
+                            (video_aligned.get_frame_offset(frame) % alignment != 0) ||
+                            (frame.length != stream.frames[index_frame].length) ||
+                            (std::memcmp(frame.data, stream.frames[index_frame].data, frame.length) != 0)
+                        ) {
+                            std::fprintf(stderr, "Failed to match frame %zu in avi aligned to %u, variant %d, source %d, of sample '%s'.\n", index_frame, alignment, variant, source, sample_names[index_sample].c_str());
+                            return 1;
+                        }
+                    }
+                }
+
+                std::remove(path);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <avi.hpp>
+
+#include "samples.hpp"
+
+#include <cstring>
+#include <vector>
+
+static bool write_file(const char* path, const unsigned char* data, size_t length) {
+    std::FILE* file = std::fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    const bool written = (std::fwrite(data, 1, length, file) == length);
+    return (std::fclose(file) == 0) && written;
+}
+
+static bool read_file(const char* path, std::vector<unsigned char>& data) {
+    std::FILE* file = std::fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    data.clear();
+    unsigned char buffer[4096];
+    size_t read = 0;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + read);
+    }
+    std::fclose(file);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    const char* path = "index_cache.avi";
+    const char* cache_path = "index_cache.avi.idx";
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        const avi::stream_type& stream = video.get_stream(0);
+        if ((stream.strf_vids == nullptr) || (stream.frames.empty()) || (stream.frames[0].length == 0)) {
+            continue;
+        }
+
+        // Opening without a cache writes one.
+        std::remove(cache_path);
+        if (!write_file(path, file.get(), length)) {
+            std::fprintf(stderr, "Failed to write avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        std::vector<unsigned char> cache;
+        {
+            avi video_cached;
+            if ((!video_cached.open(path, avi::access_type::sequential, true, cache_path)) || (video_cached.get_frames(0).size() != stream.frames.size())) {
+                std::fprintf(stderr, "Failed to open avi of sample '%s' with an index cache.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+        }
+        if ((!read_file(cache_path, cache)) || (cache.size() < sizeof(avi::index_cache_header_type) + sizeof(avi::index_cache_stream_type))) {
+            std::fprintf(stderr, "Failed to write index cache of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Mark the first frame as empty in the cache, so frames found through the cache can be told apart.
+        avi::index_cache_stream_type cache_stream;
+        std::memcpy(&cache_stream, &cache[sizeof(avi::index_cache_header_type)], sizeof(avi::index_cache_stream_type));
+        avi::index_cache_frame_type cache_frame;
+        std::memcpy(&cache_frame, &cache[cache_stream.frames_offset], sizeof(avi::index_cache_frame_type));
+        if ((cache_frame.offset + cache_frame.length > length) || (std::memcmp(&file[cache_frame.offset], stream.frames[0].data, stream.frames[0].length) != 0)) {
+            std::fprintf(stderr, "Failed to match the first frame in the index cache of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        cache_frame.length = 0;
+        std::memcpy(&cache[cache_stream.frames_offset], &cache_frame, sizeof(avi::index_cache_frame_type));
+        if (!write_file(cache_path, cache.data(), cache.size())) {
+            std::fprintf(stderr, "Failed to modify index cache of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Reopen using the cache, loading the frames and looking them up.
+        for (int variant = 0; variant < 2; ++variant) {
+            avi video_cached;
+            if (!video_cached.open(path, avi::access_type::sequential, variant == 0, cache_path)) {
+                std::fprintf(stderr, "Failed to reopen avi variant %d of sample '%s' with an index cache.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            if (video_cached.get_frame_count(0) != stream.frames.size()) {
+                std::fprintf(stderr, "Failed to count frames in avi variant %d of sample '%s' with an index cache.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            for (size_t index_frame = 0; index_frame < stream.frames.size(); ++index_frame) {
+                avi::frame_type frame;
+                if (!video_cached.get_frame(0, index_frame, frame)) {
+                    std::fprintf(stderr, "Failed to look up frame %zu in avi variant %d of sample '%s' with an index cache.\n", index_frame, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+                const unsigned long long int expected_length = (index_frame == 0) ? 0 : stream.frames[index_frame].length;
+                if ((frame.length != expected_length) || (std::memcmp(frame.data, stream.frames[index_frame].data, frame.length) != 0)) {
+                    std::fprintf(stderr, "Failed to match frame %zu in avi variant %d of sample '%s' with an index cache.\n", index_frame, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+            }
+        }
+
+        // Changing the headers makes the cache stale, so it is rebuilt.
+        std::vector<unsigned char> changed(file.get(), file.get() + length);
+        const avi::avih_type* avih = video.get_avih();
+        const size_t avih_offset = static_cast<size_t>(reinterpret_cast<const unsigned char*>(avih) - file.get());
+        changed[avih_offset + 4] ^= 0x01;
+        if (!write_file(path, changed.data(), changed.size())) {
+            std::fprintf(stderr, "Failed to write changed avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        {
+            avi video_cached;
+            if (!video_cached.open(path, avi::access_type::sequential, true, cache_path)) {
+                std::fprintf(stderr, "Failed to open changed avi of sample '%s' with an index cache.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+            if ((video_cached.get_frames(0).size() != stream.frames.size()) || (video_cached.get_frames(0)[0].length != stream.frames[0].length)) {
+                std::fprintf(stderr, "Failed to rebuild stale index cache of sample '%s'.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+        }
+
+        std::remove(path);
+        std::remove(cache_path);
+    }
+
+    return 0;
+}
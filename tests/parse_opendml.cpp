@@ -0,0 +1,219 @@
+#include <avi.hpp>
+
+#include "samples.hpp"
+
+#include <cstring>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        const avi::stream_type& stream = video.get_stream(0);
+        if (stream.strf_vids == nullptr) {
+            continue;
+        }
+
+        // Write the first stream as an OpenDML file, the first half of the frames in RIFF[AVI ] and the rest in RIFF[AVIX].
+        std::vector<unsigned char> data;
+        const auto put = [&](const void* bytes, size_t size) {
+            data.insert(data.end(), static_cast<const unsigned char*>(bytes), static_cast<const unsigned char*>(bytes) + size);
+        };
+        const auto put32 = [&](unsigned int value) {
+            put(&value, 4);
+        };
+        const auto patch32 = [&](size_t offset, unsigned int value) {
+            std::memcpy(&data[offset], &value, 4);
+        };
+        const auto begin_chunk = [&](const char* identifier, const char* form) -> size_t {
+            put(identifier, 4);
+            put32(0);
+            if (form != nullptr) {
+                put(form, 4);
+            }
+            return data.size() - ((form != nullptr) ? 8 : 4);
+        };
+        const auto end_chunk = [&](size_t size_offset) {
+            patch32(size_offset, static_cast<unsigned int>(data.size() - size_offset - 4));
+            if (data.size() % 2) {
+                data.push_back(0);
+            }
+        };
+
+        const size_t frame_count = stream.frames.size();
+        const size_t segment_frames[2] = { frame_count / 2, frame_count - (frame_count / 2) };
+        size_t super_index_offset = 0;
+        size_t standard_index_offsets[2] = {};
+
+        const auto write_movi = [&](size_t first_frame, size_t segment, std::vector<unsigned int>& movi_offsets) -> size_t {
+            const size_t movi = begin_chunk("LIST", "movi");
+            std::vector<size_t> frame_offsets;
+            for (size_t index_frame = first_frame; index_frame < first_frame + segment_frames[segment]; ++index_frame) {
+                movi_offsets.push_back(static_cast<unsigned int>(data.size() - (movi + 4)));
+                const size_t frame = begin_chunk("00dc", nullptr);
+                frame_offsets.push_back(data.size());
+                put(stream.frames[index_frame].data, stream.frames[index_frame].length);
+                end_chunk(frame);
+            }
+            // ix00, offsets are relative to the start of the LIST[movi] chunk and every frame after the first is marked as a delta frame.
+            standard_index_offsets[segment] = data.size();
+            const size_t standard_index = begin_chunk("ix00", nullptr);
+            put("\x02\x00\x00\x01", 4);
+            put32(static_cast<unsigned int>(segment_frames[segment]));
+            put("00dc", 4);
+            const unsigned long long int base_offset = movi - 4;
+            put(&base_offset, 8);
+            put32(0);
+            for (size_t index_frame = 0; index_frame < segment_frames[segment]; ++index_frame) {
+                put32(static_cast<unsigned int>(frame_offsets[index_frame] - base_offset));
+                put32(static_cast<unsigned int>(stream.frames[first_frame + index_frame].length) | ((index_frame + first_frame == 0) ? 0 : 0x80000000));
+            }
+            end_chunk(standard_index);
+            end_chunk(movi);
+            return movi;
+        };
+
+        // RIFF[AVI ]
+        const size_t riff = begin_chunk("RIFF", "AVI ");
+        {
+            const size_t hdrl = begin_chunk("LIST", "hdrl");
+            {
+                const size_t avih = begin_chunk("avih", nullptr);
+                avi::avih_type avih_data = *video.get_avih();
+                avih_data.stream_count = 1;
+                avih_data.total_frames = static_cast<unsigned int>(segment_frames[0]);
+                put(&avih_data, sizeof(avi::avih_type));
+                end_chunk(avih);
+
+                const size_t strl = begin_chunk("LIST", "strl");
+                const size_t strh = begin_chunk("strh", nullptr);
+                put(stream.strh, sizeof(avi::strh_type));
+                end_chunk(strh);
+                const size_t strf = begin_chunk("strf", nullptr);
+                put(stream.strf_vids, stream.strf_vids->header_size);
+                end_chunk(strf);
+                const size_t indx = begin_chunk("indx", nullptr);
+                put("\x04\x00\x00\x00", 4);
+                put32(2);
+                put("00dc", 4);
+                put32(0);
+                put32(0);
+                put32(0);
+                super_index_offset = data.size();
+                data.resize(data.size() + 2 * 16, 0);
+                end_chunk(indx);
+                end_chunk(strl);
+            }
+            end_chunk(hdrl);
+
+            std::vector<unsigned int> movi_offsets;
+            write_movi(0, 0, movi_offsets);
+
+            const size_t idx1 = begin_chunk("idx1", nullptr);
+            for (size_t index_frame = 0; index_frame < segment_frames[0]; ++index_frame) {
+                put("00dc", 4);
+                put32((index_frame == 0) ? 0x10 : 0);
+                put32(movi_offsets[index_frame]);
+                put32(static_cast<unsigned int>(stream.frames[index_frame].length));
+            }
+            end_chunk(idx1);
+        }
+        end_chunk(riff);
+
+        // RIFF[AVIX]
+        const size_t riff_extended = begin_chunk("RIFF", "AVIX");
+        {
+            std::vector<unsigned int> movi_offsets;
+            write_movi(segment_frames[0], 1, movi_offsets);
+        }
+        end_chunk(riff_extended);
+
+        // Point the super index at both standard indexes using 64 bit file offsets.
+        for (size_t segment = 0; segment < 2; ++segment) {
+            const unsigned long long int offset = standard_index_offsets[segment];
+            std::memcpy(&data[super_index_offset + segment * 16], &offset, 8);
+            unsigned int size = 0;
+            std::memcpy(&size, &data[standard_index_offsets[segment] + 4], 4);
+            patch32(super_index_offset + segment * 16 + 8, size + 8);
+            patch32(super_index_offset + segment * 16 + 12, static_cast<unsigned int>(segment_frames[segment]));
+        }
+
+        // Compose the same stream with room for about two frames in each RIFF chunk.
+        std::vector<avi::stream_type> streams_composed(1);
+        streams_composed[0].strh = stream.strh;
+        streams_composed[0].strf_vids = stream.strf_vids;
+        streams_composed[0].frames = stream.frames;
+        unsigned long long int largest_frame = 0;
+        for (const avi::frame_type& frame : stream.frames) {
+            largest_frame = (frame.length > largest_frame) ? frame.length : largest_frame;
+        }
+        avi::avih_type avih_composed = *video.get_avih();
+        avih_composed.stream_count = 1;
+        std::vector<unsigned char> composed;
+        if (!video.compose(&avih_composed, streams_composed, composed, 2 * (8 + largest_frame + 1))) {
+            std::fprintf(stderr, "Failed to compose OpenDML avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        unsigned int composed_riff_length = 0;
+        std::memcpy(&composed_riff_length, &composed[4], 4);
+        if ((frame_count > 2) && (8ull + composed_riff_length >= composed.size())) {
+            std::fprintf(stderr, "Failed to compose OpenDML avi of sample '%s' with more than one RIFF chunk.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Parse using the OpenDML indexes, then the idx1 index, then with no index at all and finally the composed avi.
+        for (int variant = 0; variant < 4; ++variant) {
+            if (variant == 1) {
+                std::memcpy(&data[super_index_offset - 32], "JUNK", 4);
+            }
+            if (variant == 2) {
+                for (size_t offset = 12; offset < data.size(); ) {
+                    unsigned int size = 0;
+                    std::memcpy(&size, &data[offset + 4], 4);
+                    if (std::memcmp(&data[offset], "idx1", 4) == 0) {
+                        std::memcpy(&data[offset], "JUNK", 4);
+                    }
+                    offset += 8 + size + (size % 2);
+                }
+            }
+
+            const std::vector<unsigned char>& parsed = (variant < 3) ? data : composed;
+            avi video_opendml;
+            if (!video_opendml.parse(parsed.data(), parsed.size())) {
+                std::fprintf(stderr, "Failed to parse OpenDML avi variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            const std::vector<avi::frame_type>& frames = video_opendml.get_frames(0);
+            if (frames.size() != frame_count) {
+                std::fprintf(stderr, "Failed to find all frames in OpenDML avi variant %d of sample '%s', %zu != %zu.\n", variant, sample_names[index_sample].c_str(), frames.size(), frame_count);
+                return 1;
+            }
+            for (size_t index_frame = 0; index_frame < frame_count; ++index_frame) {
+                if (
+                    (frames[index_frame].length != stream.frames[index_frame].length) ||
+                    (std::memcmp(frames[index_frame].data, stream.frames[index_frame].data, frames[index_frame].length) != 0)
+                ) {
+                    std::fprintf(stderr, "Failed to match frame %zu in OpenDML avi variant %d of sample '%s'.\n", index_frame, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
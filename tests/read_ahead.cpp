@@ -0,0 +1,106 @@
+#include <avi.hpp>
+#include <avi_reader.hpp>
+
+#include "samples.hpp"
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        const avi::stream_type& stream = video.get_stream(0);
+        if (stream.strf_vids == nullptr) {
+            continue;
+        }
+
+        // Read ahead by a single frame and by the default amount.
+        const std::string path = "samples/" + sample_names[index_sample];
+        for (int variant = 0; variant < 2; ++variant) {
+            avi_reader reader;
+            if (!reader.open(path.c_str(), 0, (variant == 0) ? 1 : avi_reader::default_read_ahead)) {
+                std::fprintf(stderr, "Failed to open avi reader variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            if (reader.get_frame_count() != stream.frames.size()) {
+                std::fprintf(stderr, "Failed to count frames with avi reader variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+
+            // Two decoder threads acquire frames in turn, holding each until they acquire the next.
+            bool matched[2] = { true, true };
+            const auto decode = [&](int thread) {
+                unsigned long long int held_number = 0;
+                bool held = false;
+                avi::frame_type frame;
+                unsigned long long int frame_number = 0;
+                while (reader.acquire_frame(frame, frame_number)) {
+                    const avi::frame_type& expected = stream.frames[static_cast<size_t>(frame_number)];
+                    if ((frame.length != expected.length) || (std::memcmp(frame.data, expected.data, frame.length) != 0)) {
+                        matched[thread] = false;
+                    }
+                    if (held) {
+                        reader.release_frame(held_number);
+                    }
+                    held_number = frame_number;
+                    held = true;
+                    if (variant == 0) {
+                        reader.release_frame(frame_number);
+                        held = false;
+                    }
+                }
+                if (held) {
+                    reader.release_frame(held_number);
+                }
+            };
+            std::thread thread_decode(decode, 1);
+            decode(0);
+            thread_decode.join();
+            if ((!matched[0]) || (!matched[1])) {
+                std::fprintf(stderr, "Failed to match frames read with avi reader variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+
+            // Seek back to the middle and read to the end again.
+            const unsigned long long int middle = stream.frames.size() / 2;
+            if (!reader.seek(middle)) {
+                std::fprintf(stderr, "Failed to seek with avi reader variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            for (unsigned long long int index_frame = middle; index_frame < stream.frames.size(); ++index_frame) {
+                avi::frame_type frame;
+                unsigned long long int frame_number = 0;
+                if ((!reader.acquire_frame(frame, frame_number)) || (frame_number != index_frame)) {
+                    std::fprintf(stderr, "Failed to read frame %llu after seeking with avi reader variant %d of sample '%s'.\n", index_frame, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+                const avi::frame_type& expected = stream.frames[static_cast<size_t>(index_frame)];
+                if ((frame.length != expected.length) || (std::memcmp(frame.data, expected.data, frame.length) != 0)) {
+                    std::fprintf(stderr, "Failed to match frame %llu after seeking with avi reader variant %d of sample '%s'.\n", index_frame, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+                reader.release_frame(frame_number);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <avi.hpp>
+#include <avi_recovery.hpp>
+
+#include "samples.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    const char* damaged_path = "recover_samples_damaged.avi";
+    const char* recovered_path = "recover_samples_recovered.avi";
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        const avi::stream_type& stream = video.get_stream(0);
+        if ((stream.strf_vids == nullptr) || (stream.frames.size() < 3)) {
+            continue;
+        }
+
+        // Compose the first stream as an OpenDML avi, with room for about two frames in each RIFF chunk.
+        std::vector<avi::stream_type> streams(1);
+        streams[0].strh = stream.strh;
+        streams[0].strf_vids = stream.strf_vids;
+        streams[0].frames = stream.frames;
+        unsigned long long int largest_frame = 0;
+        for (const avi::frame_type& frame : stream.frames) {
+            largest_frame = (frame.length > largest_frame) ? frame.length : largest_frame;
+        }
+        avi::avih_type avih = *video.get_avih();
+        avih.stream_count = 1;
+        std::vector<unsigned char> composed;
+        if (!video.compose(&avih, streams, composed, 2 * (8 + largest_frame + 1))) {
+            std::fprintf(stderr, "Failed to compose avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        avi video_composed;
+        if (!video_composed.parse(composed.data(), composed.size())) {
+            std::fprintf(stderr, "Failed to parse composed avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        std::vector<size_t> chunk_offsets;
+        for (const avi::frame_type& frame : video_composed.get_frames(0)) {
+            chunk_offsets.push_back(static_cast<size_t>(frame.data - composed.data()) - 8);
+        }
+
+        // Damage the file in three ways, each losing one frame:
+        //   Cut short in the middle of the last frame.
+        //   Every RIFF and LIST size set to garbage, the super indexes hidden and the identifier of a middle frame overwritten.
+        //   The size of a middle frame changed so it no longer leads to the next chunk.
+        const size_t lost_frame_numbers[3] = { stream.frames.size() - 1, stream.frames.size() / 2, stream.frames.size() / 3 };
+        for (int variant = 0; variant < 3; ++variant) {
+            const size_t lost_frame = lost_frame_numbers[variant];
+            std::vector<unsigned char> damaged = composed;
+            if (variant == 0) {
+                damaged.resize(chunk_offsets[lost_frame] + 8 + stream.frames[lost_frame].length / 2);
+            }
+            else if (variant == 1) {
+                const size_t hdrl_end = chunk_offsets[0];
+                for (size_t offset = hdrl_end; offset + 4 <= damaged.size(); ++offset) {
+                    if ((std::memcmp(&damaged[offset], "RIFF", 4) == 0) || (std::memcmp(&damaged[offset], "LIST", 4) == 0)) {
+                        std::memset(&damaged[offset + 4], 0xFF, 4);
+                    }
+                }
+                for (size_t offset = 0; offset + 4 <= damaged.size(); ++offset) {
+                    if (std::memcmp(&damaged[offset], "indx", 4) == 0) {
+                        std::memcpy(&damaged[offset], "JUNK", 4);
+                    }
+                }
+                std::memcpy(&damaged[chunk_offsets[lost_frame]], "XXXX", 4);
+            }
+            else {
+                damaged[chunk_offsets[lost_frame] + 4] ^= 0x10;
+            }
+            std::FILE* damaged_file = std::fopen(damaged_path, "wb");
+            if ((damaged_file == nullptr) || (std::fwrite(damaged.data(), 1, damaged.size(), damaged_file) != damaged.size()) || (std::fclose(damaged_file) != 0)) {
+                std::fprintf(stderr, "Failed to write damaged avi variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+
+            // Every frame but the one damaged must be found, in order.
+            avi_recovery recovery;
+            if ((!recovery.scan(damaged_path)) || (recovery.get_frame_count(0) != stream.frames.size() - 1) || (recovery.get_skipped_bytes() == 0)) {
+                std::fprintf(stderr, "Failed to scan damaged avi variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            for (size_t index_found = 0; index_found < recovery.get_frames(); ++index_found) {
+                const avi::frame_type& expected = stream.frames[(index_found < lost_frame) ? index_found : (index_found + 1)];
+                size_t found_stream = 0;
+                avi::frame_type found;
+                if ((!recovery.get_frame(index_found, found_stream, found)) || (found_stream != 0) || (found.length != expected.length) || (std::memcmp(found.data, expected.data, found.length) != 0)) {
+                    std::fprintf(stderr, "Failed to match frame %zu found in damaged avi variant %d of sample '%s'.\n", index_found, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+            }
+
+            // The recovered file is complete and indexed.
+            if (!recovery.write(recovered_path)) {
+                std::fprintf(stderr, "Failed to write recovered avi variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            recovery.close();
+            avi video_recovered;
+            if ((!video_recovered.open(recovered_path, avi::access_type::random, false)) || (video_recovered.get_frame_count(0) != stream.frames.size() - 1)) {
+                std::fprintf(stderr, "Failed to open recovered avi variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            for (size_t index_frame = 0; index_frame < stream.frames.size() - 1; ++index_frame) {
+                const avi::frame_type& expected = stream.frames[(index_frame < lost_frame) ? index_frame : (index_frame + 1)];
+                avi::frame_type found;
+                if ((!video_recovered.get_frame(0, index_frame, found)) || (found.length != expected.length) || (std::memcmp(found.data, expected.data, found.length) != 0)) {
+                    std::fprintf(stderr, "Failed to match frame %zu of recovered avi variant %d of sample '%s'.\n", index_frame, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+            }
+            video_recovered.close();
+            std::remove(damaged_path);
+            std::remove(recovered_path);
+        }
+    }
+
+    return 0;
+}
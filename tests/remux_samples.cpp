@@ -0,0 +1,99 @@
+#include <avi.hpp>
+#include <avi_remuxer.hpp>
+
+#include "samples.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    const char* path = "remux_samples.avi";
+    std::string previous_path;
+    std::vector<unsigned char> previous_strf_vids;
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        const avi::stream_type& stream = video.get_stream(0);
+        if ((stream.strf_vids == nullptr) || (video.get_streams() != 1)) {
+            continue;
+        }
+        const std::string sample_path = "samples/" + sample_names[index_sample];
+        const size_t frame_count = stream.frames.size();
+        unsigned long long int largest_frame = 0;
+        for (const avi::frame_type& frame : stream.frames) {
+            largest_frame = (frame.length > largest_frame) ? frame.length : largest_frame;
+        }
+
+        // Cut the middle half, join the whole file and then trim to the second half by time.
+        avi_remuxer remuxer;
+        if (
+            (!remuxer.add_frames(sample_path.c_str(), frame_count / 4, frame_count / 2)) ||
+            (!remuxer.add_frames(sample_path.c_str(), 0)) ||
+            (!remuxer.add_time(sample_path.c_str(), video.get_frame_time(0, frame_count / 2), video.get_frame_time(0, frame_count)))
+        ) {
+            std::fprintf(stderr, "Failed to add ranges of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        std::vector<avi::frame_type> expected;
+        expected.insert(expected.end(), stream.frames.begin() + static_cast<long>(frame_count / 4), stream.frames.begin() + static_cast<long>(frame_count / 4 + frame_count / 2));
+        expected.insert(expected.end(), stream.frames.begin(), stream.frames.end());
+        expected.insert(expected.end(), stream.frames.begin() + static_cast<long>(frame_count / 2), stream.frames.end());
+
+        // Write with room for about two frames in each RIFF chunk.
+        if (!remuxer.write(path, 2 * (8 + largest_frame + 1))) {
+            std::fprintf(stderr, "Failed to remux sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        {
+            avi video_remuxed;
+            if (!video_remuxed.open(path)) {
+                std::fprintf(stderr, "Failed to open remuxed avi of sample '%s'.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+            const std::vector<avi::frame_type>& frames = video_remuxed.get_frames(0);
+            if ((frames.size() != expected.size()) || (video_remuxed.get_stream(0).strh->length != expected.size())) {
+                std::fprintf(stderr, "Failed to find all frames in remuxed avi of sample '%s', %zu != %zu.\n", sample_names[index_sample].c_str(), frames.size(), expected.size());
+                return 1;
+            }
+            for (size_t index_frame = 0; index_frame < frames.size(); ++index_frame) {
+                if ((frames[index_frame].length != expected[index_frame].length) || (std::memcmp(frames[index_frame].data, expected[index_frame].data, frames[index_frame].length) != 0)) {
+                    std::fprintf(stderr, "Failed to match frame %zu in remuxed avi of sample '%s'.\n", index_frame, sample_names[index_sample].c_str());
+                    return 1;
+                }
+            }
+        }
+        std::remove(path);
+
+        // Files with different codec configurations cannot be joined.
+        const unsigned char* strf_vids = reinterpret_cast<const unsigned char*>(stream.strf_vids);
+        const std::vector<unsigned char> current_strf_vids(strf_vids, strf_vids + stream.strf_vids->header_size);
+        if ((!previous_path.empty()) && (previous_strf_vids != current_strf_vids)) {
+            avi_remuxer remuxer_mismatched;
+            if ((!remuxer_mismatched.add_frames(previous_path.c_str(), 0)) || (remuxer_mismatched.add_frames(sample_path.c_str(), 0))) {
+                std::fprintf(stderr, "Failed to reject joining sample '%s' to a different sample.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+        }
+        previous_path = sample_path;
+        previous_strf_vids = current_strf_vids;
+    }
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <avi.hpp>
+
+#include "samples.hpp"
+
+#include <cstring>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        const avi::stream_type& stream = video.get_stream(0);
+        if (stream.strf_vids == nullptr) {
+            continue;
+        }
+
+        // Compose the first stream as an OpenDML avi, with room for about two frames in each RIFF chunk.
+        std::vector<avi::stream_type> streams(1);
+        streams[0].strh = stream.strh;
+        streams[0].strf_vids = stream.strf_vids;
+        streams[0].frames = stream.frames;
+        unsigned long long int largest_frame = 0;
+        for (const avi::frame_type& frame : stream.frames) {
+            largest_frame = (frame.length > largest_frame) ? frame.length : largest_frame;
+        }
+        avi::avih_type avih = *video.get_avih();
+        avih.stream_count = 1;
+        std::vector<unsigned char> composed;
+        if (!video.compose(&avih, streams, composed, 2 * (8 + largest_frame + 1))) {
+            std::fprintf(stderr, "Failed to compose OpenDML avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Compose it again with a second copy of the stream in a single RIFF chunk with the super indexes hidden, leaving only the idx1 index to pick out the frames of each stream.
+        // The frames are repeated so lookups cross several of the positions kept in the index.
+        std::vector<avi::stream_type> streams_index(2, streams[0]);
+        while (streams_index[0].frames.size() < 300) {
+            streams_index[0].frames.insert(streams_index[0].frames.end(), stream.frames.begin(), stream.frames.end());
+        }
+        streams_index[1].frames = streams_index[0].frames;
+        avi::avih_type avih_index = avih;
+        avih_index.stream_count = 2;
+        std::vector<unsigned char> composed_index;
+        if (!video.compose(&avih_index, streams_index, composed_index)) {
+            std::fprintf(stderr, "Failed to compose avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        for (size_t offset = 0; offset + 4 <= composed_index.size(); ++offset) {
+            if (std::memcmp(&composed_index[offset], "indx", 4) == 0) {
+                std::memcpy(&composed_index[offset], "JUNK", 4);
+            }
+        }
+        avi video_index;
+        if (!video_index.parse(composed_index.data(), composed_index.size())) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s' with two streams.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Look up frames without loading them, in the sample with whatever index it has, in the OpenDML avi and using the idx1 index.
+        for (int variant = 0; variant < 3; ++variant) {
+            const unsigned char* data = (variant == 0) ? file.get() : ((variant == 1) ? composed.data() : composed_index.data());
+            const size_t data_length = (variant == 0) ? length : ((variant == 1) ? composed.size() : composed_index.size());
+            const std::vector<avi::frame_type>& frames = (variant == 2) ? streams_index[0].frames : stream.frames;
+            avi video_lookup;
+            if (!video_lookup.parse(data, data_length, false)) {
+                std::fprintf(stderr, "Failed to parse avi variant %d of sample '%s' without loading frames.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            if ((variant > 0) && (!video_lookup.get_frames(0).empty())) {
+                std::fprintf(stderr, "Failed to parse avi variant %d of sample '%s' without loading frames, the index was not used.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+            if ((video_lookup.get_frame_count(0) != frames.size()) || ((variant == 2) && (video_lookup.get_frame_count(1) != frames.size()))) {
+                std::fprintf(stderr, "Failed to count frames in avi variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+
+            // Seek backwards and forwards through the frames.
+            for (size_t index_step = 0; index_step < frames.size(); ++index_step) {
+                const size_t index_frame = (index_step % 2) ? (frames.size() - 1 - (index_step / 2)) : (index_step / 2);
+                avi::frame_type frame;
+                if (!video_lookup.get_frame(0, index_frame, frame)) {
+                    std::fprintf(stderr, "Failed to look up frame %zu in avi variant %d of sample '%s'.\n", index_frame, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+                if ((frame.length != frames[index_frame].length) || (std::memcmp(frame.data, frames[index_frame].data, frame.length) != 0)) {
+                    std::fprintf(stderr, "Failed to match frame %zu in avi variant %d of sample '%s'.\n", index_frame, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+                // The repeated frames only differ in where they are.
+                avi::frame_type frame_copy;
+                if ((variant == 2) && ((frame.data != video_index.get_frames(0)[index_frame].data) || (!video_lookup.get_frame(1, index_frame, frame_copy)) || (frame_copy.data != video_index.get_frames(1)[index_frame].data))) {
+                    std::fprintf(stderr, "Failed to match frame %zu of the second stream in avi variant %d of sample '%s'.\n", index_frame, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+
+                // A frame is shown from its time until the next frame.
+                const double time = video_lookup.get_frame_time(0, index_frame);
+                const double time_next = video_lookup.get_frame_time(0, index_frame + 1);
+                if (
+                    (video_lookup.get_frame_number(0, time) != index_frame) ||
+                    (video_lookup.get_frame_number(0, (time + time_next) / 2) != index_frame)
+                ) {
+                    std::fprintf(stderr, "Failed to seek to the time of frame %zu in avi variant %d of sample '%s'.\n", index_frame, variant, sample_names[index_sample].c_str());
+                    return 1;
+                }
+            }
+
+            avi::frame_type frame;
+            if (
+                (video_lookup.get_frame(0, frames.size(), frame)) ||
+                (video_lookup.get_frame_number(0, -1.0) != 0) ||
+                (video_lookup.get_frame_number(0, 1e9) != frames.size() - 1)
+            ) {
+                std::fprintf(stderr, "Failed to limit seeking to the frames in avi variant %d of sample '%s'.\n", variant, sample_names[index_sample].c_str());
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
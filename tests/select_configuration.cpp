@@ -0,0 +1,172 @@
+#include <avi.hpp>
+#include <huffyuv.hpp>
+
+#include "samples.hpp"
+
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Select stream.
+        unsigned int stream_number = 0xFFFFFFFF;
+        for (size_t i = 0; i < video.get_streams(); ++i) {
+            const avi::stream_type& stream = video.get_stream(i);
+            if (
+                (stream.strh->type == avi::fourcc("vids")) &&
+                ((stream.strh->handler == avi::fourcc("hfyu")) || (stream.strh->handler == avi::fourcc("HFYU")))
+            ) {
+                if (
+                    (stream.strf_vids != nullptr) &&
+                    (stream.strf_vids->compression_identifier == avi::fourcc("HFYU"))
+                ) {
+                    stream_number = i;
+                    break;
+                }
+            }
+        }
+        if (stream_number == 0xFFFFFFFF) {
+            std::fprintf(stderr, "Failed find a HFYU encoded video stream inside the avi file.\n");
+            return 1;
+        }
+
+        // Setup decode codec.
+        huffyuv codec_decode(reinterpret_cast<const unsigned char*>(video.get_stream(stream_number).strf_vids), video.get_stream(stream_number).strf_vids->header_size);
+        if (!codec_decode.is_valid()) {
+            fprintf(stderr, "Failed setup huffyuv decoder for sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode all the frames.
+        std::vector<std::unique_ptr<unsigned char[]>> frames_decoded;
+        for (size_t index_frame = 0; index_frame < sample_frames[index_sample]; ++index_frame) {
+            unsigned long long int pixels_decoded_length = codec_decode.get_decoded_image_size();
+            std::unique_ptr<unsigned char[]> pixels_decoded = std::unique_ptr<unsigned char[]>(new unsigned char[pixels_decoded_length]);
+            if (!codec_decode.decode(
+                video.get_stream(stream_number).frames[index_frame].data,
+                video.get_stream(stream_number).frames[index_frame].length,
+                pixels_decoded.get(),
+                pixels_decoded_length
+            )) {
+                fprintf(stderr, "Failed to decode frame %zu/%zu for sample '%s'.\n", index_frame, sample_frames[index_sample], sample_names[index_sample].c_str());
+                return 1;
+            }
+            frames_decoded.push_back(std::move(pixels_decoded));
+        }
+
+        // Sample a handful of frames spread across the video to select the configuration from.
+        constexpr static const size_t sampled_frame_limit = 4;
+        std::vector<const unsigned char*> frames_sampled;
+        const size_t frames_sampled_count = (frames_decoded.size() < sampled_frame_limit) ? frames_decoded.size() : sampled_frame_limit;
+        for (size_t index_sampled = 0; index_sampled < frames_sampled_count; ++index_sampled) {
+            frames_sampled.push_back(frames_decoded[index_sampled * frames_decoded.size() / frames_sampled_count].get());
+        }
+
+        huffyuv::configuration_type configuration;
+        if (!huffyuv::select_configuration(
+            codec_decode.get_image_width(),
+            codec_decode.get_image_height(),
+            codec_decode.is_interlaced(),
+            codec_decode.get_image_format(),
+            frames_sampled.data(),
+            static_cast<unsigned int>(frames_sampled.size()),
+            configuration
+        )) {
+            fprintf(stderr, "Failed to select configuration for sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Setup an encode codec from the selected configuration.
+        huffyuv codec_encode(
+            codec_decode.get_image_width(),
+            codec_decode.get_image_height(),
+            codec_decode.is_interlaced(),
+            configuration.decorrelated,
+            codec_decode.get_image_format(),
+            configuration.predictor,
+            configuration.table_data,
+            configuration.table_length
+        );
+        if (!codec_encode.is_valid()) {
+            fprintf(stderr, "Failed setup huffyuv encoder from selected configuration for sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Generate the stream header containing the selected tables and setup a decoder from it.
+        const unsigned int strf_vids_size = sizeof(avi::strf_vids_type) + 4 + codec_encode.get_packed_table_size();
+        std::unique_ptr<unsigned char[]> strf_vids_data = std::unique_ptr<unsigned char[]>(new unsigned char[strf_vids_size]);
+        if (!codec_encode.generate_stream_header(strf_vids_data.get(), strf_vids_size)) {
+            fprintf(stderr, "Failed to generate stream header for sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        huffyuv codec_decode_selected(strf_vids_data.get(), strf_vids_size);
+        if (!codec_decode_selected.is_valid()) {
+            fprintf(stderr, "Failed setup huffyuv decoder from selected stream header for sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        unsigned long long int total_sampled_length = 0;
+        for (size_t index_frame = 0; index_frame < frames_decoded.size(); ++index_frame) {
+            unsigned long long int pixels_encoded_length = codec_encode.get_max_encoded_size();
+            std::unique_ptr<unsigned char[]> pixels_encoded = std::unique_ptr<unsigned char[]>(new unsigned char[pixels_encoded_length]);
+            if (!codec_encode.encode(
+                frames_decoded[index_frame].get(),
+                codec_encode.get_decoded_image_size(),
+                pixels_encoded.get(),
+                pixels_encoded_length
+            )) {
+                fprintf(stderr, "Failed to encode frame %zu/%zu with selected configuration for sample '%s'.\n", index_frame, sample_frames[index_sample], sample_names[index_sample].c_str());
+                return 1;
+            }
+            for (size_t index_sampled = 0; index_sampled < frames_sampled.size(); ++index_sampled) {
+                if (frames_sampled[index_sampled] == frames_decoded[index_frame].get()) {
+                    total_sampled_length += pixels_encoded_length;
+                }
+            }
+
+            unsigned long long int pixels_decoded_length = codec_decode_selected.get_decoded_image_size();
+            std::unique_ptr<unsigned char[]> pixels_decoded = std::unique_ptr<unsigned char[]>(new unsigned char[pixels_decoded_length]);
+            if (!codec_decode_selected.decode(
+                pixels_encoded.get(),
+                pixels_encoded_length,
+                pixels_decoded.get(),
+                pixels_decoded_length
+            )) {
+                fprintf(stderr, "Failed to decode frame %zu/%zu with selected configuration for sample '%s'.\n", index_frame, sample_frames[index_sample], sample_names[index_sample].c_str());
+                return 1;
+            }
+
+            for (size_t index_byte = 0; index_byte < pixels_decoded_length; ++index_byte) {
+                if (pixels_decoded.get()[index_byte] != frames_decoded[index_frame].get()[index_byte]) {
+                    fprintf(stderr, "Failed to match frame %zu for sample '%s' at byte %zu.\n", index_frame, sample_names[index_sample].c_str(), index_byte);
+                    return 1;
+                }
+            }
+        }
+
+        // The estimate ignores how the padding of each frame falls, so it can only be short by at most four bytes a frame.
+        if ((total_sampled_length < configuration.estimated_length) || (total_sampled_length > configuration.estimated_length + 4 * frames_sampled.size())) {
+            fprintf(stderr, "Failed to estimate size for sample '%s', %llu bytes estimated but %llu bytes encoded.\n", sample_names[index_sample].c_str(), configuration.estimated_length, total_sampled_length);
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <avi.hpp>
+#include <avi_shared_reader.hpp>
+
+#include "samples.hpp"
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        const std::string path = "samples/" + sample_names[index_sample];
+        avi_shared_reader reader;
+        if ((!reader.open(path.c_str())) || (reader.get_streams() != video.get_streams())) {
+            std::fprintf(stderr, "Failed to open shared reader of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Each thread walks every stream with a cursor from a different starting frame, and reads frames out of order into its own buffer.
+        constexpr static const size_t thread_count = 4;
+        bool matched[thread_count] = {};
+        const auto read = [&](size_t thread) {
+            matched[thread] = true;
+            std::vector<unsigned char> buffer;
+            for (size_t index_stream = 0; index_stream < video.get_streams(); ++index_stream) {
+                const std::vector<avi::frame_type>& frames = video.get_frames(index_stream);
+                matched[thread] = matched[thread] && (reader.get_frame_count(index_stream) == frames.size());
+                if (frames.empty()) {
+                    continue;
+                }
+
+                avi_shared_reader::cursor_type cursor(reader, index_stream, (thread * frames.size()) / thread_count);
+                avi::frame_type frame;
+                while (cursor.next(frame)) {
+                    const avi::frame_type& expected = frames[static_cast<size_t>(cursor.tell() - 1)];
+                    matched[thread] = matched[thread] && (frame.length == expected.length) && (std::memcmp(frame.data, expected.data, frame.length) == 0);
+                }
+                matched[thread] = matched[thread] && (cursor.tell() == frames.size());
+
+                for (size_t index_frame = 0; index_frame < frames.size(); ++index_frame) {
+                    const size_t frame_number = (index_frame * 7 + thread) % frames.size();
+                    matched[thread] = matched[thread] && (reader.read_frame(index_stream, frame_number, buffer));
+                    matched[thread] = matched[thread] && (buffer.size() == frames[frame_number].length) && (std::memcmp(buffer.data(), frames[frame_number].data, buffer.size()) == 0);
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t thread = 1; thread < thread_count; ++thread) {
+            threads.emplace_back(read, thread);
+        }
+        read(0);
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        for (size_t thread = 0; thread < thread_count; ++thread) {
+            if (!matched[thread]) {
+                std::fprintf(stderr, "Failed to match frames read by thread %zu from shared reader of sample '%s'.\n", thread, sample_names[index_sample].c_str());
+                return 1;
+            }
+        }
+
+        // A buffer too small for the frame is refused.
+        if ((reader.get_frame_count(0) > 0) && (reader.get_frame_length(0, 0) > 0)) {
+            unsigned char small_buffer[1];
+            unsigned long long int frame_length = 0;
+            if (reader.read_frame(0, 0, small_buffer, reader.get_frame_length(0, 0) - 1, frame_length)) {
+                std::fprintf(stderr, "Failed to refuse a small buffer in shared reader of sample '%s'.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -2,6 +2,8 @@
 
 #include "samples.hpp"
 
+#include <cstring>
+
 int main(int argc, char* argv[]) {
     static_cast<void>(argc);
     static_cast<void>(argv);
@@ -44,6 +46,35 @@ int main(int argc, char* argv[]) {
             std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
             return 1;
         }
+
+        // Open the same avi by mapping the file, it must match the loaded copy.
+        avi video_mapped;
+        const std::string path = "samples/" + sample_names[index_sample];
+        if (!video_mapped.open(path.c_str(), avi::access_type::random)) {
+            std::fprintf(stderr, "Failed to open avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        if (video_mapped.get_streams() != video.get_streams()) {
+            std::fprintf(stderr, "Failed to match streams of mapped avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        for (size_t index_stream = 0; index_stream < video.get_streams(); ++index_stream) {
+            const std::vector<avi::frame_type>& frames = video.get_frames(index_stream);
+            const std::vector<avi::frame_type>& frames_mapped = video_mapped.get_frames(index_stream);
+            if (frames_mapped.size() != frames.size()) {
+                std::fprintf(stderr, "Failed to match frame count of mapped avi of sample '%s'.\n", sample_names[index_sample].c_str());
+                return 1;
+            }
+            for (size_t index_frame = 0; index_frame < frames.size(); ++index_frame) {
+                if (
+                    (frames_mapped[index_frame].length != frames[index_frame].length) ||
+                    (std::memcmp(frames_mapped[index_frame].data, frames[index_frame].data, frames[index_frame].length) != 0)
+                ) {
+                    std::fprintf(stderr, "Failed to match frame %zu of mapped avi of sample '%s'.\n", index_frame, sample_names[index_sample].c_str());
+                    return 1;
+                }
+            }
+        }
     }
 
     return 0;
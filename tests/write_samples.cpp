@@ -0,0 +1,89 @@
+#include <avi.hpp>
+#include <avi_writer.hpp>
+
+#include "samples.hpp"
+
+#include <cstring>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+
+    const char* path = "write_samples.avi";
+
+    for (size_t index_sample = 0; index_sample < sample_names.size(); ++index_sample) {
+        // Load avi.
+        size_t length = 0;
+        std::unique_ptr<unsigned char[]> file = load_video(index_sample, length);
+        if ((file == nullptr) || (length == 0)) {
+            fprintf(stderr, "Failed to load avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Decode avi.
+        avi video;
+        if (!video.parse(file.get(), length)) {
+            std::fprintf(stderr, "Failed to parse avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        const avi::stream_type& stream = video.get_stream(0);
+        if (stream.strf_vids == nullptr) {
+            continue;
+        }
+
+        // Write the first stream a frame at a time, with room for about two frames in each RIFF chunk.
+        // Every third frame is written as an uncompressed chunk, as huffyuv::encode stored frames are.
+        std::vector<avi::stream_type> streams(1);
+        streams[0].strh = stream.strh;
+        streams[0].strf_vids = stream.strf_vids;
+        unsigned long long int largest_frame = 0;
+        for (const avi::frame_type& frame : stream.frames) {
+            largest_frame = (frame.length > largest_frame) ? frame.length : largest_frame;
+        }
+        avi::avih_type avih = *video.get_avih();
+        avih.stream_count = 1;
+
+        avi_writer writer;
+        if (!writer.open(path, &avih, streams, 2 * (8 + largest_frame + 1))) {
+            std::fprintf(stderr, "Failed to open avi writer for sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        for (size_t index_frame = 0; index_frame < stream.frames.size(); ++index_frame) {
+            if (!writer.write_frame(0, stream.frames[index_frame].data, stream.frames[index_frame].length, index_frame % 3 == 0)) {
+                std::fprintf(stderr, "Failed to write frame %zu for sample '%s'.\n", index_frame, sample_names[index_sample].c_str());
+                return 1;
+            }
+        }
+        if (!writer.close()) {
+            std::fprintf(stderr, "Failed to close avi writer for sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+
+        // Read the file back and check the frames and the lengths filled in on close.
+        avi video_written;
+        if (!video_written.open(path)) {
+            std::fprintf(stderr, "Failed to open written avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        const std::vector<avi::frame_type>& frames = video_written.get_frames(0);
+        if ((frames.size() != stream.frames.size()) || (video_written.get_stream(0).strh->length != stream.frames.size())) {
+            std::fprintf(stderr, "Failed to find all frames in written avi of sample '%s'.\n", sample_names[index_sample].c_str());
+            return 1;
+        }
+        for (size_t index_frame = 0; index_frame < frames.size(); ++index_frame) {
+            if (
+                (frames[index_frame].length != stream.frames[index_frame].length) ||
+                (std::memcmp(frames[index_frame].data, stream.frames[index_frame].data, frames[index_frame].length) != 0) ||
+                (video_written.is_frame_uncompressed(frames[index_frame]) != (index_frame % 3 == 0))
+            ) {
+                std::fprintf(stderr, "Failed to match frame %zu in written avi of sample '%s'.\n", index_frame, sample_names[index_sample].c_str());
+                return 1;
+            }
+        }
+        video_written.close();
+        std::remove(path);
+    }
+
+    return 0;
+}
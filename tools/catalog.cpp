@@ -0,0 +1,33 @@
+#include <avi_catalog.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Catalogue the video streams of avi files, reading only their headers.
+//   catalog [-j THREADS] PATH...
+// Directories are searched for files with an avi extension, the report is written to standard output.
+int main(int argc, char* argv[]) {
+    unsigned int thread_count = 0;
+    int index = 1;
+    if ((index + 1 < argc) && (std::strcmp(argv[index], "-j") == 0)) {
+        thread_count = static_cast<unsigned int>(std::strtoul(argv[index + 1], nullptr, 10));
+        index += 2;
+    }
+    if (index >= argc) {
+        std::fprintf(stderr, "Usage: %s [-j THREADS] PATH...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> paths(&argv[index], &argv[argc]);
+    avi_catalog catalog;
+    if (!catalog.scan(paths, thread_count)) {
+        return 1;
+    }
+    if (!catalog.write_report(stdout)) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+#include <avi_recovery.hpp>
+
+#include <cstdio>
+
+// Recover the frames of a truncated or damaged avi into a new, fully indexed, file.
+//   recover INPUT OUTPUT
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::fprintf(stderr, "Usage: %s INPUT OUTPUT\n", argv[0]);
+        return 1;
+    }
+
+    avi_recovery recovery;
+    if (!recovery.scan(argv[1])) {
+        return 1;
+    }
+    for (size_t stream = 0; stream < recovery.get_avi().get_streams(); ++stream) {
+        std::printf("Stream %zu: %llu frames recovered.\n", stream, recovery.get_frame_count(stream));
+    }
+    std::printf("Skipped %llu damaged bytes.\n", recovery.get_skipped_bytes());
+
+    if (!recovery.write(argv[2])) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+#include <avi_remuxer.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Cut, trim and join avi files without re-encoding.
+//   remux OUTPUT INPUT [-f FIRST COUNT | -t START END] [INPUT [-f FIRST COUNT | -t START END]]...
+// Each input is copied whole unless followed by a range of frames, or a range of times in seconds.
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::fprintf(stderr, "Usage: %s OUTPUT INPUT [-f FIRST COUNT | -t START END] [INPUT [-f FIRST COUNT | -t START END]]...\n", argv[0]);
+        return 1;
+    }
+
+    avi_remuxer remuxer;
+    for (int index = 2; index < argc; ) {
+        const char* input = argv[index++];
+        bool added = false;
+        if ((index + 2 < argc) && (std::strcmp(argv[index], "-f") == 0)) {
+            added = remuxer.add_frames(input, std::strtoull(argv[index + 1], nullptr, 10), std::strtoull(argv[index + 2], nullptr, 10));
+            index += 3;
+        }
+        else if ((index + 2 < argc) && (std::strcmp(argv[index], "-t") == 0)) {
+            added = remuxer.add_time(input, std::strtod(argv[index + 1], nullptr), std::strtod(argv[index + 2], nullptr));
+            index += 3;
+        }
+        else {
+            added = remuxer.add_frames(input, 0);
+        }
+        if (!added) {
+            std::fprintf(stderr, "Failed to add '%s'.\n", input);
+            return 1;
+        }
+    }
+
+    if (!remuxer.write(argv[1])) {
+        return 1;
+    }
+    return 0;
+}